@@ -0,0 +1,110 @@
+/*
+MpscQueue：无锁的多生产者、单消费者队列（Dmitry Vyukov的侵入式MPSC队列）
+- push只有一次原子交换（XCHG），不会阻塞，也不会被其它生产者阻塞
+- pop/consume只能在唯一的消费者线程中调用，不需要原子的读-改-写
+- 生产者在交换head_之后、链接next之前的一瞬间，消费者会暂时看不到这个元素（返回false），
+  但empty()仍然返回false，消费者稍后再取即可
+*/
+
+#ifndef MUDUO_BASE_MPSCQUEUE_H
+#define MUDUO_BASE_MPSCQUEUE_H
+
+#include <boost/noncopyable.hpp>
+
+#include <algorithm>
+
+#include <stddef.h>
+
+namespace muduo
+{
+    ///
+    /// Unbounded lock-free multi-producer single-consumer queue.
+    ///
+    template<typename T>
+    class MpscQueue : boost::noncopyable
+    {
+    private:
+        struct Node
+        {
+            Node* volatile next;
+            T value;
+
+            Node() : next(NULL) {}
+            explicit Node(const T& x) : next(NULL), value(x) {}
+        };
+
+        static const size_t kCacheLineSize = 64;
+
+        Node* head_;    // 最新放入的节点，生产者之间用原子交换竞争
+        char  pad_[kCacheLineSize - sizeof(Node*)];     // head_和tail_放在不同的cache line，避免伪共享
+        Node* tail_;    // 已经取走的最后一个节点（哨兵），只有消费者访问
+
+    public:
+        MpscQueue()
+            : head_(new Node),
+              tail_(head_)
+        {}
+
+        ~MpscQueue()
+        {
+            while (tail_ != NULL) {
+                Node* next = tail_->next;
+                delete tail_;
+                tail_ = next;
+            }
+        }
+
+        /// Thread safe, wait-free apart from the allocation.
+        void push(const T& x)
+        {
+            Node* node = new Node(x);
+            Node* prev = __atomic_exchange_n(&head_, node, __ATOMIC_SEQ_CST);
+            __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+        }
+
+        /// Consumer thread only.
+        /// @return false if nothing (visible) to pop.
+        bool pop(T* x)
+        {
+            Node* next = __atomic_load_n(&tail_->next, __ATOMIC_ACQUIRE);
+            if (next == NULL) {
+                return false;
+            }
+            using std::swap;
+            swap(*x, next->value);  // 不拷贝，next成为新的哨兵
+            delete tail_;
+            tail_ = next;
+            return true;
+        }
+
+        /// Consumer thread only.
+        /// Pops and calls @c f on the elements pushed before this call,
+        /// elements pushed by @c f itself are left for the next call.
+        /// @return number of elements consumed.
+        template<typename F>
+        size_t consume(F f)
+        {
+            Node* last = __atomic_load_n(&head_, __ATOMIC_ACQUIRE);
+            size_t n = 0;
+            T x;
+            while (tail_ != last && pop(&x)) {
+                f(x);
+                x = T();    // 尽早释放x持有的资源
+                ++n;
+            }
+            return n;
+        }
+
+        /// Consumer thread only, seq_cst so that it orders with a preceding store
+        /// of the consumer (see EventLoop::loop()).
+        /// An element being pushed counts as non-empty.
+        bool empty() const
+        {
+            return __atomic_load_n(&head_, __ATOMIC_SEQ_CST) == tail_;
+        }
+
+    }; // class MpscQueue
+
+} // namespace muduo
+
+#endif  // MUDUO_BASE_MPSCQUEUE_H
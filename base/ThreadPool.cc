@@ -0,0 +1,152 @@
+#include <WebServer/base/ThreadPool.h>
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+
+#include <assert.h>
+#include <stdio.h>
+
+using namespace muduo;
+
+ThreadPool::ThreadPool(const string& name)
+    : mutex_(),
+      notEmpty_(mutex_),
+      notFull_(mutex_),
+      name_(name),
+      maxQueueSize_(0),
+      running_(false)
+{
+    stats_.queueSize = 0;
+    stats_.peakQueueSize = 0;
+    stats_.numTasks = 0;
+    stats_.numRejected = 0;
+    stats_.totalWaitUs = 0;
+    stats_.maxWaitUs = 0;
+}
+
+ThreadPool::~ThreadPool()
+{
+    if (running_) {
+        stop();
+    }
+}
+
+void ThreadPool::start(int numThreads)
+{
+    assert(threads_.empty());
+    running_ = true;
+    threads_.reserve(numThreads);
+    for (int i = 0; i < numThreads; ++i) {
+        char id[32];
+        snprintf(id, sizeof id, "%d", i + 1);
+        threads_.push_back(new Thread(
+            boost::bind(&ThreadPool::runInThread, this), name_ + id));
+        threads_[i].start();
+    }
+}
+
+void ThreadPool::stop()
+{
+    {
+        MutexLockGuard lock(mutex_);
+        running_ = false;
+        notEmpty_.notifyall();
+        notFull_.notifyall();
+    }
+    for_each(threads_.begin(), threads_.end(), boost::bind(&Thread::join, _1));
+}
+
+bool ThreadPool::isFull() const
+{
+    mutex_.assertLocked();
+    return maxQueueSize_ > 0 && queue_.size() >= maxQueueSize_;
+}
+
+void ThreadPool::push(const Task& task)
+{
+    Entry entry;
+    entry.task = task;
+    entry.enqueued = Timestamp::now();
+    queue_.push_back(entry);
+    if (queue_.size() > stats_.peakQueueSize) {
+        stats_.peakQueueSize = queue_.size();
+    }
+    notEmpty_.notify();
+}
+
+void ThreadPool::run(const Task& task)
+{
+    if (threads_.empty()) {
+        task(); // 没有工作线程，直接在调用者线程执行
+        return;
+    }
+    MutexLockGuard lock(mutex_);
+    while (isFull() && running_) {
+        notFull_.wait();
+    }
+    if (running_) {
+        push(task);
+    }
+}
+
+bool ThreadPool::tryRun(const Task& task)
+{
+    MutexLockGuard lock(mutex_);
+    if (!running_ || threads_.empty() || isFull()) {
+        ++stats_.numRejected;
+        return false;
+    }
+    push(task);
+    return true;
+}
+
+bool ThreadPool::take(Task* task)
+{
+    MutexLockGuard lock(mutex_);
+    // always use a while-loop, due to spurious wakeup
+    while (queue_.empty() && running_) {
+        notEmpty_.wait();
+    }
+    if (queue_.empty()) {
+        return false;   // stop()之后，队列中剩下的任务都已经执行完
+    }
+    Entry& entry = queue_.front();
+    int64_t waitUs = Timestamp::now().microSecondsSinceEpoch()
+                   - entry.enqueued.microSecondsSinceEpoch();
+    ++stats_.numTasks;
+    stats_.totalWaitUs += waitUs;
+    if (waitUs > stats_.maxWaitUs) {
+        stats_.maxWaitUs = waitUs;
+    }
+    task->swap(entry.task);
+    queue_.pop_front();
+    if (maxQueueSize_ > 0) {
+        notFull_.notify();
+    }
+    return true;
+}
+
+// 任务抛出的异常由Thread::runInThread捕获
+void ThreadPool::runInThread()
+{
+    Task task;
+    while (take(&task)) {
+        task();
+        task = Task();  // 尽早释放任务持有的对象
+    }
+}
+
+size_t ThreadPool::queueSize() const
+{
+    MutexLockGuard lock(mutex_);
+    return queue_.size();
+}
+
+ThreadPool::Stats ThreadPool::stats() const
+{
+    MutexLockGuard lock(mutex_);
+    Stats s = stats_;
+    s.queueSize = queue_.size();
+    return s;
+}
@@ -0,0 +1,95 @@
+/*
+ThreadPool：固定数目的工作线程，从一个（可以有界的）任务队列中取任务执行
+- run()在队列满时阻塞，tryRun()不阻塞，队列满时返回false，IO线程应该用tryRun()
+- 记录队列深度（当前/峰值）和任务在队列中的等待时间，用于观察工作线程是否跟得上
+*/
+
+#ifndef MUDUO_BASE_THREADPOOL_H
+#define MUDUO_BASE_THREADPOOL_H
+
+#include <WebServer/base/Condition.h>
+#include <WebServer/base/Mutex.h>
+#include <WebServer/base/Thread.h>
+#include <WebServer/base/Timestamp.h>
+#include <WebServer/base/Types.h>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <deque>
+
+#include <stdint.h>
+
+namespace muduo
+{
+    class ThreadPool : boost::noncopyable
+    {
+    public:
+        typedef boost::function<void ()> Task;
+
+        /// A snapshot of the queue, all wait times in microseconds.
+        struct Stats
+        {
+            size_t  queueSize;      // 当前排队的任务数
+            size_t  peakQueueSize;  // 排队任务数的峰值
+            int64_t numTasks;       // 已经开始执行的任务数
+            int64_t numRejected;    // tryRun()因为队列满而拒绝的任务数
+            int64_t totalWaitUs;    // 开始执行的任务在队列中等待的总时间
+            int64_t maxWaitUs;      // 单个任务的最长等待时间
+        };
+
+    private:
+        struct Entry
+        {
+            Task task;
+            Timestamp enqueued;     // 放入队列的时间
+        };
+
+        mutable MutexLock       mutex_;
+        Condition               notEmpty_;
+        Condition               notFull_;
+        string                  name_;
+        boost::ptr_vector<Thread> threads_;
+        std::deque<Entry>       queue_;
+        size_t                  maxQueueSize_;  // 0表示不限
+        bool                    running_;
+        Stats                   stats_;         // 由mutex_保护
+
+        void runInThread();
+        bool take(Task* task);
+        bool isFull() const;        // 调用时持有mutex_
+        void push(const Task& task);// 调用时持有mutex_
+
+    public:
+        explicit ThreadPool(const string& name = string("ThreadPool"));
+        ~ThreadPool();
+
+        /// Must be called before start(), 0 (the default) for no limit.
+        void setMaxQueueSize(size_t maxSize)
+        { maxQueueSize_ = maxSize; }
+
+        void start(int numThreads);
+        /// Wakes up the threads and joins them, tasks still queued are run
+        /// before the threads exit. run() and tryRun() take no new tasks then.
+        void stop();
+
+        const string& name() const
+        { return name_; }
+
+        /// Blocks while the queue is full.
+        /// Runs @c task in the caller if the pool has no threads.
+        void run(const Task& task);
+
+        /// Never blocks, returns false if the queue is full or the pool is
+        /// not running, the task is not run then.
+        bool tryRun(const Task& task);
+
+        size_t queueSize() const;
+        Stats stats() const;
+
+    }; // class ThreadPool
+
+} // namespace muduo
+
+#endif  // MUDUO_BASE_THREADPOOL_H
@@ -12,15 +12,17 @@
 using namespace muduo;
 using namespace muduo::net;
 
-Acceptor::Acceptor()
+Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reuseport)
     : loop_(loop),
       acceptSocket_(sockets::createNonblockingOrDie()),
       acceptChannel_(loop, acceptSocket_.fd()),
       listenning_(false),
-      idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))// 预先准备了一个空闲的描述符
+      idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)),// 预先准备了一个空闲的描述符
+      maxAcceptsPerWake_(kDefaultMaxAcceptsPerWake)
 {
     assert(idleFd_ >= 0);
     acceptSocket_.setReuseAddr(true);// 设置地址重复利用
+    acceptSocket_.setReusePort(reuseport);// 必须在bind之前设置
     acceptSocket_.bindAddress(listenAddr);// 绑定，但还没开始监听
     acceptChannel_.setReadCallback(
         boost::bind(&Acceptor::handleRead, this));// 设置一个“读”的回调函数
@@ -45,28 +47,46 @@ void Acceptor::listen()
 void Acceptor::handleRead()
 {
     loop_->assertInLoopThread();
-    InetAddress peerAddr(0);
-    // FIXME loop until no more
-    int connfd = acceptSocket_.accept(&peerAddr);
-    if (connfd >= 0)
+    numWakeups_.increment();
+    // listening socket是非阻塞的，连续accept直到backlog为空（EAGAIN）或者达到上限，
+    // 一次突发的连接只需要一次poll；设置上限是为了不让accept饿死其它通道
+    int accepted = 0;
+    for (int i = 0; i < maxAcceptsPerWake_; ++i)
     {
-        // string hostport = peerAddr.toIpPort();
-        // LOG_TRACE << "Accepts of " << hostport;
-        if (newConnectionCallback_) {
-            newConnectionCallback_(connfd, peerAddr);
+        InetAddress peerAddr(0);
+        // accept4(SOCK_NONBLOCK | SOCK_CLOEXEC)，不需要再调用fcntl
+        int connfd = acceptSocket_.accept(&peerAddr);
+        if (connfd >= 0)
+        {
+            ++accepted;
+            // string hostport = peerAddr.toIpPort();
+            // LOG_TRACE << "Accepts of " << hostport;
+            if (newConnectionCallback_) {
+                newConnectionCallback_(connfd, peerAddr);
+            }
+            else {
+                sockets::close(connfd);
+            }
         }
-        else {
-            sockets::close(connfd);
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            break;// 已经没有等待的连接了
         }
-    }
-    else
-    {
-        if (errno == EMFILE) {
+        else if (errno == EMFILE)
+        {
             // 文件描述符太多
             ::close(idleFd_);
             idleFd_ = ::accept(acceptSocket_.fd(), NULL, NULL);
             ::close(idleFd_);// 接受了马上关闭
             idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
         }
+        // ECONNABORTED、EINTR等：这个连接作废，继续accept下一个
+    }
+
+    if (accepted > 0) {
+        numAccepted_.add(accepted);
+        if (accepted > maxAcceptedPerWake_.get()) {
+            maxAcceptedPerWake_.getAndSet(accepted);// 只有loop线程修改
+        }
     }
-}
\ No newline at end of file
+}
@@ -13,9 +13,12 @@ Channel用于观察此listening socket的readable事件，并回调Acceptor::han
 #include <boost/function.hpp>
 #include <boost/noncopuable.hpp>
 
+#include <WebServer/base/Atomic.h>
 #include <WebServer/net/Channel.h>
 #include <WebServer/net/Socket.h>
 
+#include <assert.h>
+
 namespace muduo
 {
     namespace net
@@ -37,20 +40,43 @@ namespace muduo
             NewConnectionCallback newConnectionCallback_;// 
             bool listenning_;// 是否处于监听的状态
             int idleFd_;// 
+            int maxAcceptsPerWake_;// 每次可读事件最多accept的连接数
+            // 统计，在loop线程中修改，其它线程可以读
+            AtomicInt64 numWakeups_;    // handleRead被调用的次数
+            AtomicInt64 numAccepted_;   // 接受的连接总数
+            AtomicInt32 maxAcceptedPerWake_;// 一次可读事件接受连接数的最大值
         
         public:
             typedef boost::function<void (int sockfd, const InetAddress&)> NewConnectionCallback;
 
-            Acceptor(EventLoop* loop, const InetAddress& listenAddr);
+            /// @param reuseport set SO_REUSEPORT, so that several acceptors
+            /// (usually one per EventLoop) may listen on the same address.
+            Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reuseport = false);
             ~Acceptor();
 
             void setNewConnectionCallback(const NewConnectionCallback& cb) {
                 newConnectionCallback_ = cb;
             }
             
+            /// Accepts up to @c n connections per readiness event, stops earlier
+            /// when the backlog is drained (EAGAIN). Default is kDefaultMaxAcceptsPerWake.
+            /// Must be called in the loop thread.
+            void setMaxAcceptsPerWake(int n) {
+                assert(n > 0);
+                maxAcceptsPerWake_ = n;
+            }
+
             bool listenning() const { return listenning_; }
             void listen();
 
+            /// Statistics, safe to read from other threads.
+            /// numAccepted() / numWakeups() is the average accepts per wake.
+            int64_t numWakeups() { return numWakeups_.get(); }
+            int64_t numAccepted() { return numAccepted_.get(); }
+            int maxAcceptedPerWake() { return maxAcceptedPerWake_.get(); }
+
+            static const int kDefaultMaxAcceptsPerWake = 16;
+
         }; // class Acceptor
 
     } // namespace net
@@ -0,0 +1,100 @@
+#include <WebServer/net/BlockPool.h>
+
+#include <WebServer/base/Logging.h>
+
+#include <assert.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t BlockPool::kDefaultBlockSize;
+const int    BlockPool::kDefaultBlocksPerSlab;
+
+BlockPool::BlockPool(size_t blockSize, int blocksPerSlab)
+    : blockSize_(blockSize),
+      blocksPerSlab_(blocksPerSlab),
+      freeList_(NULL),
+      numFree_(0),
+      numInUse_(0)
+{
+    assert(blockSize_ >= sizeof(FreeBlock));
+    assert(blocksPerSlab_ > 0);
+}
+
+BlockPool::~BlockPool()
+{
+    // ChainBuffer持有BlockPoolPtr，所以析构时不应再有借出的block
+    assert(numInUse_ == 0);
+    for (size_t i = 0; i < slabs_.size(); ++i) {
+        ::free(slabs_[i]);
+    }
+}
+
+char* BlockPool::allocate()
+{
+    MutexLockGuard lock(mutex_);
+    if (freeList_ == NULL) {
+        allocateSlab();
+    }
+    FreeBlock* block = freeList_;
+    freeList_ = block->next;
+    --numFree_;
+    ++numInUse_;
+    return reinterpret_cast<char*>(block);
+}
+
+void BlockPool::deallocate(char* block)
+{
+    assert(block != NULL);
+    FreeBlock* fb = reinterpret_cast<FreeBlock*>(block);
+    MutexLockGuard lock(mutex_);
+    assert(numInUse_ > 0);
+    fb->next = freeList_;   // 头插，最近归还的block最先被复用，cache更友好
+    freeList_ = fb;
+    ++numFree_;
+    --numInUse_;
+}
+
+size_t BlockPool::numFree() const
+{
+    MutexLockGuard lock(mutex_);
+    return numFree_;
+}
+
+size_t BlockPool::numInUse() const
+{
+    MutexLockGuard lock(mutex_);
+    return numInUse_;
+}
+
+size_t BlockPool::numSlabs() const
+{
+    MutexLockGuard lock(mutex_);
+    return slabs_.size();
+}
+
+// 调用者必须持有mutex_
+void BlockPool::allocateSlab()
+{
+    mutex_.assertLocked();
+    char* slab = static_cast<char*>(::malloc(blockSize_ * blocksPerSlab_));
+    if (slab == NULL) {
+        LOG_SYSFATAL << "BlockPool::allocateSlab";
+    }
+    slabs_.push_back(slab);
+    // 从后往前插入空闲链表，这样allocate()按地址递增的顺序返回block
+    for (int i = blocksPerSlab_ - 1; i >= 0; --i) {
+        FreeBlock* fb = reinterpret_cast<FreeBlock*>(slab + i * blockSize_);
+        fb->next = freeList_;
+        freeList_ = fb;
+    }
+    numFree_ += blocksPerSlab_;
+    LOG_TRACE << "BlockPool::allocateSlab " << slabs_.size() << " slabs";
+}
+
+const BlockPoolPtr& BlockPool::defaultPool()
+{
+    static BlockPoolPtr pool(new BlockPool);
+    return pool;
+}
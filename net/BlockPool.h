@@ -0,0 +1,76 @@
+/*
+BlockPool：定长内存块池（slab）
+- 每次向系统申请一整块slab，再切成若干个定长block，用空闲链表管理
+- 每个EventLoop拥有一个BlockPool，供ChainBuffer使用，避免频繁malloc/free
+- 用shared_ptr管理，ChainBuffer持有BlockPoolPtr，保证block归还时pool仍然存在
+*/
+
+#ifndef MUDUO_NET_BLOCKPOOL_H
+#define MUDUO_NET_BLOCKPOOL_H
+
+#include <WebServer/base/Mutex.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
+#include <stddef.h>
+
+namespace muduo
+{
+    namespace net
+    {
+        ///
+        /// Fixed-size block allocator backed by slabs.
+        ///
+        /// Blocks are handed out by the owning IO thread, but may be returned
+        /// from any thread (a TcpConnection can be destroyed anywhere), so the
+        /// free list is guarded by a mutex which is uncontended in practice.
+        class BlockPool : boost::noncopyable
+        {
+        private:
+            struct FreeBlock
+            {
+                FreeBlock* next;
+            };
+
+            void allocateSlab();    // 申请一个新的slab并切成block放入空闲链表
+
+            const size_t blockSize_;    // 每个block的大小
+            const int    blocksPerSlab_;// 每个slab包含的block个数
+            mutable MutexLock mutex_;
+            FreeBlock*   freeList_;     // 空闲block链表
+            std::vector<char*> slabs_;  // 已申请的slab，析构时统一释放
+            size_t       numFree_;      // 空闲block个数
+            size_t       numInUse_;     // 已借出的block个数
+
+        public:
+            static const size_t kDefaultBlockSize = 16 * 1024;
+            static const int    kDefaultBlocksPerSlab = 64;
+
+            explicit BlockPool(size_t blockSize = kDefaultBlockSize,
+                               int blocksPerSlab = kDefaultBlocksPerSlab);
+            ~BlockPool();
+
+            /// Returns a block of blockSize() bytes, never NULL.
+            char* allocate();
+            /// Gives a block back to the pool, thread safe.
+            void deallocate(char* block);
+
+            size_t blockSize() const { return blockSize_; }
+            size_t numFree() const;
+            size_t numInUse() const;
+            size_t numSlabs() const;
+
+            /// Process-wide pool for buffers not bound to an EventLoop.
+            static const boost::shared_ptr<BlockPool>& defaultPool();
+
+        }; // class BlockPool
+
+        typedef boost::shared_ptr<BlockPool> BlockPoolPtr;
+
+    } // namespace net
+
+} // namespace muduo
+
+#endif  // MUDUO_NET_BLOCKPOOL_H
@@ -1,4 +1,5 @@
 #include <WebServer/net/Buffer.h>
+#include <WebServer/net/ReadSpill.h>
 #include <WebServer/net/SocketsOps.h>
 
 #include <errno.h>
@@ -40,4 +41,41 @@ size_t Buffer::readFd(int fd, int* savedErrno)
         append(extrabuf, n - writable);
     }
     return n;
-}
\ No newline at end of file
+}
+
+// 不再用栈上的extrabuf，而是用本IO线程共享的spill区。
+// 另外用最近几次读到的字节数（指数加权平均）预测这次会读到多少，
+// 预先在buffer_中留出空间，大多数情况下数据直接读进buffer_，不需要再append拷贝一次
+ssize_t Buffer::readFd(int fd, int* savedErrno, ReadSpill* spill)
+{
+    const size_t hint = std::min(readSizeHint_, spill->size());
+    if (hint > writableBytes()) {
+        ensureWritableBytes(hint);
+    }
+    struct iovec vec[2];
+    const size_t writable = writableBytes();
+    vec[0].iov_base = begin() + writerIndex_;
+    vec[0].iov_len = writable;
+    vec[1].iov_base = spill->data();
+    vec[1].iov_len = spill->size();
+    // buffer_剩余空间已经比spill区大时，就不需要第二块缓冲区了
+    const int iovcnt = (writable < spill->size()) ? 2 : 1;
+    const ssize_t n = sockets::readv(fd, vec, iovcnt);
+    size_t overflow = 0;
+    if (n < 0) {
+        *savedErrno = errno;
+    }
+    else if (implicit_cast<size_t>(n) <= writable) {
+        writerIndex_ += n;
+    }
+    else {
+        overflow = n - writable;
+        writerIndex_ = buffer_.size();
+        append(spill->data(), overflow);
+    }
+    if (n > 0) {
+        readSizeHint_ = (readSizeHint_ * 3 + n) / 4;
+        spill->record(overflow);
+    }
+    return n;
+}
@@ -5,6 +5,7 @@
 #include <WebServer/base/StringPiece.h>
 #include <WebServer/base/Types.h>
 
+#include <WebServer/net/CharScan.h>
 #include <WebServer/net/Endian.h>
 
 #include <algorithm>
@@ -28,12 +29,15 @@ namespace muduo
         /// |                   |                  |                  |
         /// 0      <=      readerIndex   <=   writerIndex    <=     size
         /// @endcode
+        class ReadSpill;
+
         class Buffer : public muduo::copyable
         {
         private:
             std::vector<char> buffer_;	    // buffer_是动态数组
             size_t readerIndex_;			// 读位置
             size_t writerIndex_;			// 写位置
+            size_t readSizeHint_;			// 根据最近几次readFd读到的字节数预测的下次读取大小
 
             static const char kCRLF[];	// "\r\n"
 
@@ -44,19 +48,52 @@ namespace muduo
             Buffer()
                 : buffer_(kCheapPrepend + kInitialSize),
                   readerIndex_(kCheapPrepend),
-                  writerIndex_(kCheapPrepend)
+                  writerIndex_(kCheapPrepend),
+                  readSizeHint_(0)
             {
                 assert(readableBytes() == 0);
                 assert(writableBytes() == kInitialSize);
                 assert(prependableBytes() == kCheapPrepend);
             }
 
+            /// Tag for a Buffer without storage, see takeStorage().
+            struct DeferStorage {};
+
+            /// Constructs a buffer without storage, takeStorage() must be called
+            /// before use. Lets a pool hand in recycled storage without allocating.
+            explicit Buffer(DeferStorage)
+                : readerIndex_(kCheapPrepend),
+                  writerIndex_(kCheapPrepend),
+                  readSizeHint_(0)
+            {}
+
             // default copy-ctor, dtor and assignment are fine
 
+            /// Uses @c storage (grown to the initial size if smaller) as the
+            /// underlying storage and empties the buffer.
+            /// @c storage receives the old storage.
+            void takeStorage(std::vector<char>* storage) {
+                buffer_.swap(*storage);
+                if (buffer_.size() < kCheapPrepend + kInitialSize) {
+                    buffer_.resize(kCheapPrepend + kInitialSize);
+                }
+                readerIndex_ = kCheapPrepend;
+                writerIndex_ = kCheapPrepend;
+            }
+
+            /// Gives the underlying storage to @c storage (which should be empty),
+            /// the buffer must not be used afterwards except for takeStorage().
+            void releaseStorage(std::vector<char>* storage) {
+                buffer_.swap(*storage);
+                readerIndex_ = kCheapPrepend;
+                writerIndex_ = kCheapPrepend;
+            }
+
             void swap(Buffer& rhs) {
                 buffer_.swap(rhs.buffer_);
                 std::swap(readerIndex_, rhs.readerIndex_);
                 std::swap(writerIndex_, rhs.writerIndex_);
+                std::swap(readSizeHint_, rhs.readSizeHint_);
             }
 
             size_t readableBytes() const
@@ -72,17 +109,16 @@ namespace muduo
             { return begin() + readerIndex_; }
 
             // 查找"\r\n"
+            // SIMD查找，见CharScan
             const char* findCRLF() const {
-                const char* crlf = std::search(peek(), beginWrite(), kCRLF, kCRLF + 2);
-                return crlf = beginWrite() ? NULL : crlf;
+                return scan::findCRLF(peek(), beginWrite());
             }
 
             const char* findCRLF(const char* start) const
             {
                 assert(start >= peek());
                 assert(start <= beginWrite());
-                const char* crlf = std::search(start, beginWrite(), kCRLF, kCRLF + 2);
-                return crlf = beginWrite() ? NULL : crlf;
+                return scan::findCRLF(start, beginWrite());
             }
 
             // retrieve returns void, to prevent
@@ -294,6 +330,8 @@ namespace muduo
             /// It may implement with readv(2)
             /// @return result of read(2), @c errno is saved
             ssize_t readFd(int fd, int* savedErrno);
+            /// Same, overflow goes to the loop's @c spill instead of a stack array.
+            ssize_t readFd(int fd, int* savedErrno, ReadSpill* spill);
 
 
         private:
@@ -0,0 +1,237 @@
+#include <WebServer/net/ChainBuffer.h>
+#include <WebServer/net/SocketsOps.h>
+
+#include <algorithm>
+
+#include <errno.h>
+#include <limits.h>   // IOV_MAX
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+    // 一次writev最多使用的iovec个数，放在栈上
+    const int kMaxIovecs = IOV_MAX;
+}
+
+ChainBuffer::ChainBuffer(const BlockPoolPtr& pool)
+    : pool_(pool),
+      readable_(0)
+{
+    assert(pool_);
+}
+
+ChainBuffer::~ChainBuffer()
+{
+    // 所有block都要归还给pool
+    while (!blocks_.empty()) {
+        releaseFront();
+    }
+}
+
+void ChainBuffer::swap(ChainBuffer& rhs)
+{
+    pool_.swap(rhs.pool_);
+    blocks_.swap(rhs.blocks_);
+    std::swap(readable_, rhs.readable_);
+}
+
+void ChainBuffer::appendBlock()
+{
+    Block block;
+    block.data = pool_->allocate();
+    block.readerIndex = 0;
+    block.writerIndex = 0;
+    blocks_.push_back(block);
+}
+
+void ChainBuffer::releaseFront()
+{
+    assert(!blocks_.empty());
+    if (!blocks_.front().chunk) {
+        pool_->deallocate(blocks_.front().data);
+    }
+    blocks_.pop_front();    // 外部chunk只是引用计数减一
+}
+
+void ChainBuffer::retrieve(size_t len)
+{
+    assert(len <= readableBytes());
+    readable_ -= len;
+    while (len > 0) {
+        Block& front = blocks_.front();
+        size_t n = std::min(len, front.writerIndex - front.readerIndex);
+        front.readerIndex += n;
+        len -= n;
+        // 读完的block立即归还，最后一个block保留下来继续写
+        if (front.readerIndex == front.writerIndex) {
+            if (blocks_.size() > 1 || front.chunk) {
+                releaseFront();
+            }
+            else {
+                front.readerIndex = 0;
+                front.writerIndex = 0;
+            }
+        }
+    }
+}
+
+void ChainBuffer::retrieveAll()
+{
+    while (blocks_.size() > 1 || (!blocks_.empty() && blocks_.front().chunk)) {
+        releaseFront();
+    }
+    if (!blocks_.empty()) {
+        blocks_.front().readerIndex = 0;
+        blocks_.front().writerIndex = 0;
+    }
+    readable_ = 0;
+}
+
+string ChainBuffer::retrieveAsString(size_t len)
+{
+    assert(len <= readableBytes());
+    string result;
+    result.reserve(len);
+    size_t left = len;
+    for (BlockList::const_iterator it = blocks_.begin(); left > 0; ++it) {
+        size_t n = std::min(left, it->writerIndex - it->readerIndex);
+        result.append(it->data + it->readerIndex, n);
+        left -= n;
+    }
+    retrieve(len);
+    return result;
+}
+
+void ChainBuffer::copyOut(void* dst, size_t len) const
+{
+    assert(len <= readableBytes());
+    char* out = static_cast<char*>(dst);
+    for (BlockList::const_iterator it = blocks_.begin(); len > 0; ++it) {
+        size_t n = std::min(len, it->writerIndex - it->readerIndex);
+        ::memcpy(out, it->data + it->readerIndex, n);
+        out += n;
+        len -= n;
+    }
+}
+
+void ChainBuffer::append(const char* /*restrict*/ data, size_t len)
+{
+    const size_t capacity = blockSize();
+    readable_ += len;
+    while (len > 0) {
+        if (!tailWritable()) {
+            appendBlock();  // 链尾没有空间了，挂一个新block，已有数据不动
+        }
+        Block& back = blocks_.back();
+        size_t n = std::min(len, capacity - back.writerIndex);
+        ::memcpy(back.data + back.writerIndex, data, n);
+        back.writerIndex += n;
+        data += n;
+        len -= n;
+    }
+}
+
+void ChainBuffer::append(const ChunkPtr& chunk, size_t offset)
+{
+    assert(chunk);
+    assert(offset <= chunk->size());
+    if (offset == chunk->size()) {
+        return;
+    }
+    Block block;
+    block.data = const_cast<char*>(chunk->data());  // 只读，不会通过data写入
+    block.readerIndex = offset;
+    block.writerIndex = chunk->size();
+    block.chunk = chunk;
+    blocks_.push_back(block);
+    readable_ += block.writerIndex - offset;
+}
+
+int ChainBuffer::readableIovecs(struct iovec* iov, int maxIov) const
+{
+    int cnt = 0;
+    for (BlockList::const_iterator it = blocks_.begin();
+         it != blocks_.end() && cnt < maxIov; ++it)
+    {
+        size_t n = it->writerIndex - it->readerIndex;
+        if (n > 0) {
+            iov[cnt].iov_base = it->data + it->readerIndex;
+            iov[cnt].iov_len = n;
+            ++cnt;
+        }
+    }
+    return cnt;
+}
+
+// 与Buffer::readFd的思路相同，但第二块缓冲区直接是一个新的block，
+// 读到的数据不需要再append拷贝一次
+ssize_t ChainBuffer::readFd(int fd, int* savedErrno)
+{
+    const size_t capacity = blockSize();
+    if (!tailWritable()) {
+        appendBlock();
+    }
+    Block& tail = blocks_.back();
+    const size_t writable = capacity - tail.writerIndex;
+
+    Block spare;
+    spare.data = pool_->allocate();
+    spare.readerIndex = 0;
+    spare.writerIndex = 0;
+
+    struct iovec vec[2];
+    vec[0].iov_base = tail.data + tail.writerIndex;
+    vec[0].iov_len = writable;
+    vec[1].iov_base = spare.data;
+    vec[1].iov_len = capacity;
+
+    const ssize_t n = sockets::readv(fd, vec, 2);
+    if (n < 0) {
+        *savedErrno = errno;
+    }
+    else if (implicit_cast<size_t>(n) <= writable) {
+        tail.writerIndex += n;
+    }
+    else {
+        tail.writerIndex = capacity;
+        spare.writerIndex = n - writable;
+        blocks_.push_back(spare);
+        spare.data = NULL;  // 已经挂到链上
+    }
+    if (spare.data != NULL) {
+        pool_->deallocate(spare.data);
+    }
+    if (n > 0) {
+        readable_ += n;
+    }
+    return n;
+}
+
+ssize_t ChainBuffer::writeFd(int fd, int* savedErrno, size_t maxBytes)
+{
+    struct iovec vec[kMaxIovecs];
+    int iovcnt = readableIovecs(vec, kMaxIovecs);
+    // 截断到maxBytes，后面的数据这次不发送
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        if (total + vec[i].iov_len >= maxBytes) {
+            vec[i].iov_len = maxBytes - total;
+            iovcnt = i + 1;
+            break;
+        }
+        total += vec[i].iov_len;
+    }
+    if (iovcnt == 0 || maxBytes == 0) {
+        return 0;
+    }
+    const ssize_t n = sockets::writev(fd, vec, iovcnt);
+    if (n < 0) {
+        *savedErrno = errno;
+    }
+    else {
+        retrieve(n);
+    }
+    return n;
+}
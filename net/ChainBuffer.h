@@ -0,0 +1,208 @@
+/*
+ChainBuffer：由定长block串成的链式缓冲区
+- 与Buffer提供相同的peek/retrieve/append接口
+- append时只会在链尾追加新的block，已有数据永远不会被拷贝或搬移（没有resize/memmove）
+- block来自所属EventLoop的BlockPool（slab）
+- 可以导出iovec视图，一次writev就能把所有block发送出去
+- 也可以直接挂上一个引用计数的只读chunk（ChunkPtr），不拷贝数据
+*/
+
+#ifndef MUDUO_NET_CHAINBUFFER_H
+#define MUDUO_NET_CHAINBUFFER_H
+
+#include <WebServer/base/StringPiece.h>
+#include <WebServer/base/Types.h>
+
+#include <WebServer/net/BlockPool.h>
+#include <WebServer/net/Endian.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <deque>
+
+#include <assert.h>
+#include <string.h>
+#include <sys/uio.h>  // struct iovec
+
+namespace muduo
+{
+    namespace net
+    {
+        /// An immutable, reference counted piece of data, may be shared by
+        /// several ChainBuffers (and threads) without copying.
+        typedef boost::shared_ptr<const string> ChunkPtr;
+
+        /// A chain of fixed-size blocks, drawn from a BlockPool.
+        ///
+        /// @code
+        /// +---------------+   +---------------+   +---------------+
+        /// | xxx| readable |-->|   readable    |-->| readable| free|
+        /// +---------------+   +---------------+   +---------------+
+        ///  first block                              last block
+        /// @endcode
+        ///
+        /// peek() only exposes the first block, use readableIovecs()
+        /// or copyOut() to look at data spanning several blocks.
+        class ChainBuffer : boost::noncopyable
+        {
+        private:
+            struct Block
+            {
+                char*    data;
+                size_t   readerIndex;
+                size_t   writerIndex;
+                ChunkPtr chunk;     // 非空表示这是外部chunk，只读，不属于pool
+            };
+            typedef std::deque<Block> BlockList;
+
+            size_t blockSize() const { return pool_->blockSize(); }
+            bool   tailWritable() const             // 链尾是否还能写
+            {
+                return !blocks_.empty() && !blocks_.back().chunk
+                    && blocks_.back().writerIndex < blockSize();
+            }
+            void   appendBlock();                  // 从pool中取一个新的block挂到链尾
+            void   releaseFront();                 // 将第一个block归还给pool
+
+            BlockPoolPtr pool_;
+            BlockList    blocks_;
+            size_t       readable_;    // 所有block中可读字节数之和
+
+        public:
+            explicit ChainBuffer(const BlockPoolPtr& pool = BlockPool::defaultPool());
+            ~ChainBuffer();
+
+            void swap(ChainBuffer& rhs);
+
+            size_t readableBytes() const
+            { return readable_; }
+
+            size_t numBlocks() const
+            { return blocks_.size(); }
+
+            /// Start of the first block, which holds contiguousBytes() bytes.
+            const char* peek() const
+            {
+                return blocks_.empty() ? NULL
+                    : blocks_.front().data + blocks_.front().readerIndex;
+            }
+
+            size_t contiguousBytes() const
+            {
+                return blocks_.empty() ? 0
+                    : blocks_.front().writerIndex - blocks_.front().readerIndex;
+            }
+
+            void retrieve(size_t len);
+            void retrieveAll();
+
+            string retrieveAllAsString()
+            {
+                return retrieveAsString(readableBytes());
+            }
+
+            string retrieveAsString(size_t len);
+
+            /// Copies the first @c len readable bytes into @c dst without retrieving.
+            void copyOut(void* dst, size_t len) const;
+
+            void append(const StringPiece& str)
+            {
+                append(str.data(), str.size());
+            }
+
+            void append(const char* /*restrict*/ data, size_t len);
+
+            void append(const void* /*restrict*/ data, size_t len)
+            {
+                append(static_cast<const char*>(data), len);
+            }
+
+            /// Links @c chunk (from @c offset) into the chain by reference.
+            void append(const ChunkPtr& chunk, size_t offset = 0);
+
+            ///
+            /// Append int32_t using network endian
+            ///
+            void appendInt32(int32_t x)
+            {
+                int32_t be32 = sockets::hostToNetwork32(x);
+                append(&be32, sizeof be32);
+            }
+
+            void appendInt16(int16_t x)
+            {
+                int16_t be16 = sockets::hostToNetwork16(x);
+                append(&be16, sizeof be16);
+            }
+
+            void appendInt8(int8_t x)
+            {
+                append(&x, sizeof x);
+            }
+
+            ///
+            /// Peek int32_t from network endian, may span two blocks.
+            ///
+            /// Require: buf->readableBytes() >= sizeof(int32_t)
+            int32_t peekInt32() const
+            {
+                assert(readableBytes() >= sizeof(int32_t));
+                int32_t be32 = 0;
+                copyOut(&be32, sizeof be32);
+                return sockets::networkToHost32(be32);
+            }
+
+            int16_t peekInt16() const
+            {
+                assert(readableBytes() >= sizeof(int16_t));
+                int16_t be16 = 0;
+                copyOut(&be16, sizeof be16);
+                return sockets::networkToHost16(be16);
+            }
+
+            int8_t peekInt8() const
+            {
+                assert(readableBytes() >= sizeof(int8_t));
+                return *peek();
+            }
+
+            int32_t readInt32()
+            {
+                int32_t result = peekInt32();
+                retrieve(sizeof result);
+                return result;
+            }
+
+            int16_t readInt16()
+            {
+                int16_t result = peekInt16();
+                retrieve(sizeof result);
+                return result;
+            }
+
+            int8_t readInt8()
+            {
+                int8_t result = peekInt8();
+                retrieve(sizeof result);
+                return result;
+            }
+
+            /// Fills at most @c maxIov iovecs describing the readable bytes,
+            /// in order. @return number of iovecs filled.
+            int readableIovecs(struct iovec* iov, int maxIov) const;
+
+            /// Read data directly into the tail block and fresh blocks with readv(2).
+            /// @return result of readv(2), @c errno is saved
+            ssize_t readFd(int fd, int* savedErrno);
+
+            /// Write readable bytes (no more than @c maxBytes) with one writev(2),
+            /// using at most IOV_MAX blocks, written bytes are retrieved.
+            /// @return result of writev(2), @c errno is saved
+            ssize_t writeFd(int fd, int* savedErrno, size_t maxBytes = static_cast<size_t>(-1));
+
+        }; // class ChainBuffer
+    } // namespace net
+} // namespace muduo
+
+#endif  // MUDUO_NET_CHAINBUFFER_H
@@ -29,6 +29,7 @@ Channel::Channel(EverntLoop* loop, int fd__)
       revents_(0),
       index_(-1),// channel还未添加到poll/epoll关注时
       logHup_(true),
+      edgeTriggered_(false),
       tied_(false),
       eventHandling_(false)
 {
@@ -73,7 +74,8 @@ void Channel::handleEvent(Timestamp receiveTime) {
 
 void Channel::handleEventWithGuard(Timestamp receiveTime) {
     eventHandling_ = true;
-    if ((revents_ & POLLHUP) && (revents_ & POLLIN)) {
+    // 还有POLLIN时先读，读到0再关闭，否则对方关闭前发来的数据会丢失
+    if ((revents_ & POLLHUP) && !(revents_ & POLLIN)) {
         if (logHup_) {
             LOG_WARN << "Channel::handle_event() POLLHUP";
         }
@@ -92,13 +94,15 @@ void Channel::handleEventWithGuard(Timestamp receiveTime) {
         }
     }
 
-    if (revents_ & (POLLIN | POLLPRI | POLLRDHUP)) {
+    // 边沿触发时暂停读（disableReading）之后POLLIN仍被关注，忽略
+    if ((revents_ & (POLLIN | POLLPRI | POLLRDHUP)) && (!edgeTriggered_ || isReading())) {
         if (readCallback_) {
             readCallback_(receiveTime);
         }
     }
 
-    if (revents_ & POLLOUT) {
+    // 边沿触发时POLLOUT一直被关注，没有数据要写时忽略
+    if ((revents_ & POLLOUT) && (!edgeTriggered_ || isWriting())) {
         if (writeCallback_) {
             writeCallback_();
         }
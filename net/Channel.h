@@ -49,6 +49,7 @@ namespace muduo
             int         revents_;   // poll/epoll返回的事件
             int         index_;     // used by Poller.表示在poll的事件数组中的序号 / 在Epoll中表示通道的状态
             bool        logHup_;    // for POLLHUP
+            bool        edgeTriggered_; // 边沿触发：POLLIN和POLLOUT一直注册在poller中，直到disableAll()
 
             boost::weak_ptr<void> tie_; // 负责生存期的控制；（弱引用的指针）
             bool tied_;
@@ -85,12 +86,28 @@ namespace muduo
             // int revents() const { return revents_; }
             bool isNoneEvent() const { return events_ == kNoneEvent; }
 
+            // 边沿触发时也要update：EPOLL_CTL_MOD会再检查一次可读，暂停期间到达的数据不会丢失通知
             void enableReading() { events_ |= kReadEvent; update(); }
-            //void disableReading() { events_ &= ~kReadEvent; update(); }
-            void enableWriting() { events_ |= kWriteEvent; update(); }
-            void disableWriting() { events_ &= ~kWriteEvent; update(); }
+            // 边沿触发时不update：events_可能变成kNoneEvent，poller会把fd删掉，之后的POLLOUT就收不到了
+            void disableReading() { events_ &= ~kReadEvent; if (!edgeTriggered_) update(); }
+            void enableWriting() { events_ |= kWriteEvent; if (!edgeTriggered_) update(); }
+            void disableWriting() { events_ &= ~kWriteEvent; if (!edgeTriggered_) update(); }
             void disableAll() { events_ = kNoneEvent; update(); }// 不关注事件了
             bool isWriting() const { return events_ & kWriteEvent; }
+            bool isReading() const { return events_ & kReadEvent; }
+
+            /// Edge-triggered mode, must be set before the channel is added to the poller,
+            /// and only if Poller::supportsEdgeTriggered().
+            /// The owner must read/write until EAGAIN on each event.
+            /// In this mode POLLIN and POLLOUT stay registered until disableAll(),
+            /// so disableReading() and enableWriting()/disableWriting() only change
+            /// a flag, events are ignored when not reading/writing.
+            /// enableReading() still updates, which re-arms a readable fd.
+            void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+            bool isEdgeTriggered() const { return edgeTriggered_; }
+            /// The events to register with the poller.
+            int pollEvents() const
+            { return edgeTriggered_ && !isNoneEvent() ? kReadEvent | kWriteEvent : events_; }
 
             // for Poller
             int index() { return index_; }
@@ -0,0 +1,296 @@
+#include <WebServer/net/CharScan.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)   // x86-64，或者开启了SSE2的i386
+#define MUDUO_SCAN_X86 1
+#include <emmintrin.h>  // SSE2
+#include <immintrin.h>  // AVX2
+#endif
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+    typedef const char* (*FindCRLFFunc)(const char*, const char*);
+    typedef const char* (*FindCharFunc)(const char*, const char*, char);
+    typedef const char* (*FindNonTokenFunc)(const char*, const char*);
+
+    // tchar = "!" / "#" / "$" / "%" / "&" / "'" / "*" / "+" / "-" / "." /
+    //         "^" / "_" / "`" / "|" / "~" / DIGIT / ALPHA
+    struct TokenTable
+    {
+        bool isToken[256];
+
+        TokenTable()
+        {
+            memset(isToken, 0, sizeof isToken);
+            for (int c = '0'; c <= '9'; ++c) isToken[c] = true;
+            for (int c = 'a'; c <= 'z'; ++c) isToken[c] = true;
+            for (int c = 'A'; c <= 'Z'; ++c) isToken[c] = true;
+            const char* special = "!#$%&'*+-.^_`|~";
+            for (const char* p = special; *p; ++p) {
+                isToken[static_cast<unsigned char>(*p)] = true;
+            }
+        }
+    };
+    const TokenTable g_token;
+
+    inline bool isToken(char c)
+    { return g_token.isToken[static_cast<unsigned char>(c)]; }
+
+    // 逐字节的实现，也用来处理SIMD实现的尾部
+    const char* findCRLFScalar(const char* begin, const char* end)
+    {
+        for (const char* p = begin; p + 1 < end; ++p) {
+            if (p[0] == '\r' && p[1] == '\n') {
+                return p;
+            }
+        }
+        return NULL;
+    }
+
+    const char* findCharScalar(const char* begin, const char* end, char c)
+    {
+        const void* p = memchr(begin, c, end - begin);
+        return p ? static_cast<const char*>(p) : end;
+    }
+
+    const char* findNonTokenScalar(const char* begin, const char* end)
+    {
+        const char* p = begin;
+        while (p < end && isToken(*p)) {
+            ++p;
+        }
+        return p;
+    }
+
+#ifdef MUDUO_SCAN_X86
+    // ctz of a non-zero mask
+    inline int firstBit(uint32_t mask)
+    { return __builtin_ctz(mask); }
+
+    // 每次比较16个字节：'\r'的位置与下一个字节是'\n'的位置相与
+    // p+16可能是'\n'，所以要求p+17 <= end
+    const char* findCRLFSse2(const char* begin, const char* end)
+    {
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i lf = _mm_set1_epi8('\n');
+        const char* p = begin;
+        for (; p + 17 <= end; p += 16) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+            uint32_t mask = _mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(a, cr), _mm_cmpeq_epi8(b, lf)));
+            if (mask) {
+                return p + firstBit(mask);
+            }
+        }
+        return findCRLFScalar(p, end);
+    }
+
+    const char* findCharSse2(const char* begin, const char* end, char c)
+    {
+        const __m128i v = _mm_set1_epi8(c);
+        const char* p = begin;
+        for (; p + 16 <= end; p += 16) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(a, v));
+            if (mask) {
+                return p + firstBit(mask);
+            }
+        }
+        return findCharScalar(p, end, c);
+    }
+
+    // 按高低4位查表（pshufb）：lo表的第lo项中，第hi位表示字符(hi<<4|lo)是tchar
+    // hi表的第hi项为1<<hi（hi >= 8即非ASCII，为0），两者相与非0即是tchar
+    // pshufb是SSSE3的指令，SSE2只有逐个比较17个分隔符，比查表（scalar）还慢
+    #define MUDUO_TCHAR_LO_TABLE \
+        0xE8, 0xFC, 0xF8, 0xFC, 0xFC, 0xFC, 0xFC, 0xFC, 0xF8, 0xF8, 0xF4, 0x54, 0xD0, 0x54, 0xF4, 0x70
+    #define MUDUO_TCHAR_HI_TABLE \
+        0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, static_cast<char>(0x80), 0, 0, 0, 0, 0, 0, 0, 0
+
+    __attribute__((target("ssse3")))
+    const char* findNonTokenSsse3(const char* begin, const char* end)
+    {
+        const __m128i loTable = _mm_setr_epi8(MUDUO_TCHAR_LO_TABLE);
+        const __m128i hiTable = _mm_setr_epi8(MUDUO_TCHAR_HI_TABLE);
+        const __m128i nibble = _mm_set1_epi8(0x0F);
+        const char* p = begin;
+        for (; p + 16 <= end; p += 16) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i lo = _mm_shuffle_epi8(loTable, _mm_and_si128(a, nibble));
+            __m128i hi = _mm_shuffle_epi8(hiTable, _mm_and_si128(_mm_srli_epi16(a, 4), nibble));
+            __m128i bad = _mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128());
+            uint32_t mask = _mm_movemask_epi8(bad);
+            if (mask) {
+                return p + firstBit(mask);
+            }
+        }
+        return findNonTokenScalar(p, end);
+    }
+
+    __attribute__((target("avx2")))
+    const char* findCRLFAvx2(const char* begin, const char* end)
+    {
+        const __m256i cr = _mm256_set1_epi8('\r');
+        const __m256i lf = _mm256_set1_epi8('\n');
+        const char* p = begin;
+        for (; p + 33 <= end; p += 32) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+            uint32_t mask = _mm256_movemask_epi8(
+                _mm256_and_si256(_mm256_cmpeq_epi8(a, cr), _mm256_cmpeq_epi8(b, lf)));
+            if (mask) {
+                return p + firstBit(mask);
+            }
+        }
+        _mm256_zeroupper();// 尾部交给SSE2，先清掉ymm的高位，避免AVX-SSE切换的代价
+        return findCRLFSse2(p, end);
+    }
+
+    __attribute__((target("avx2")))
+    const char* findCharAvx2(const char* begin, const char* end, char c)
+    {
+        const __m256i v = _mm256_set1_epi8(c);
+        const char* p = begin;
+        for (; p + 32 <= end; p += 32) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, v));
+            if (mask) {
+                return p + firstBit(mask);
+            }
+        }
+        _mm256_zeroupper();
+        return findCharSse2(p, end, c);
+    }
+
+    // 与findNonTokenSsse3相同，一次32个字节
+    __attribute__((target("avx2")))
+    const char* findNonTokenAvx2(const char* begin, const char* end)
+    {
+        const __m256i loTable = _mm256_setr_epi8(MUDUO_TCHAR_LO_TABLE, MUDUO_TCHAR_LO_TABLE);
+        const __m256i hiTable = _mm256_setr_epi8(MUDUO_TCHAR_HI_TABLE, MUDUO_TCHAR_HI_TABLE);
+        const __m256i nibble = _mm256_set1_epi8(0x0F);
+        const char* p = begin;
+        for (; p + 32 <= end; p += 32) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            __m256i lo = _mm256_shuffle_epi8(loTable, _mm256_and_si256(a, nibble));
+            __m256i hi = _mm256_shuffle_epi8(hiTable,
+                                             _mm256_and_si256(_mm256_srli_epi16(a, 4), nibble));
+            __m256i bad = _mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), _mm256_setzero_si256());
+            uint32_t mask = _mm256_movemask_epi8(bad);
+            if (mask) {
+                return p + firstBit(mask);
+            }
+        }
+        _mm256_zeroupper();
+        return findNonTokenSsse3(p, end);  // 支持AVX2的CPU都支持SSSE3
+    }
+
+    // __builtin_cpu_supports的参数必须是字面量
+    bool cpuHasSsse3()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("ssse3");
+    }
+
+    bool cpuHasAvx2()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+#endif  // MUDUO_SCAN_X86
+
+    // 常量初始化为逐字节的实现，下面的scanInitializer在main之前（只有一个线程时）选好最终的实现，
+    // 之后只读，IO线程之间没有数据竞争。在它之前（其它编译单元的静态初始化中）调用也能得到正确结果
+    FindCRLFFunc     g_findCRLF     = findCRLFScalar;
+    FindCharFunc     g_findChar     = findCharScalar;
+    FindNonTokenFunc g_findNonToken = findNonTokenScalar;
+    scan::Impl       g_impl         = scan::kScalar;
+
+    bool useImpl(scan::Impl impl)
+    {
+        switch (impl)
+        {
+            case scan::kScalar:
+                g_findCRLF = findCRLFScalar;
+                g_findChar = findCharScalar;
+                g_findNonToken = findNonTokenScalar;
+                break;
+#ifdef MUDUO_SCAN_X86
+            case scan::kSse2:
+                g_findCRLF = findCRLFSse2;
+                g_findChar = findCharSse2;
+                g_findNonToken = cpuHasSsse3() ? findNonTokenSsse3 : findNonTokenScalar;
+                break;
+            case scan::kAvx2:
+                if (!cpuHasAvx2()) {
+                    return false;
+                }
+                g_findCRLF = findCRLFAvx2;
+                g_findChar = findCharAvx2;
+                g_findNonToken = findNonTokenAvx2;
+                break;
+#endif
+            default:
+                return false;
+        }
+        g_impl = impl;
+        return true;
+    }
+
+    class ScanInitializer
+    {
+    public:
+        ScanInitializer()
+        {
+            if (!useImpl(scan::kAvx2) && !useImpl(scan::kSse2)) {
+                useImpl(scan::kScalar);
+            }
+        }
+    };
+
+    ScanInitializer scanInitializer;
+}
+
+const char* scan::findCRLF(const char* begin, const char* end)
+{
+    return g_findCRLF(begin, end);
+}
+
+const char* scan::findChar(const char* begin, const char* end, char c)
+{
+    return g_findChar(begin, end, c);
+}
+
+const char* scan::findNonToken(const char* begin, const char* end)
+{
+    return g_findNonToken(begin, end);
+}
+
+scan::Impl scan::impl()
+{
+    return g_impl;
+}
+
+const char* scan::implName(Impl impl)
+{
+    switch (impl)
+    {
+        case kSse2:
+            return "sse2";
+        case kAvx2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+bool scan::setImpl(Impl impl)
+{
+    return useImpl(impl);
+}
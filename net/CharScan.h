@@ -0,0 +1,49 @@
+/*
+CharScan：在一段字节中查找分隔符，HTTP解析和Buffer::findCRLF使用
+- x86上有SSE2和AVX2两套实现，程序启动时（main之前）按CPU支持的指令集选择
+- 其它平台（或者强制指定时）使用逐字节的实现
+- 所有实现的结果完全相同，只是速度不同
+*/
+
+#ifndef MUDUO_NET_CHARSCAN_H
+#define MUDUO_NET_CHARSCAN_H
+
+namespace muduo
+{
+    namespace net
+    {
+        namespace scan
+        {
+            enum Impl
+            {
+                kScalar,
+                kSse2,
+                kAvx2,
+            };
+
+            /// First "\r\n" in [begin, end), points to the '\r', or NULL.
+            const char* findCRLF(const char* begin, const char* end);
+
+            /// First @c c in [begin, end), or @c end like std::find.
+            const char* findChar(const char* begin, const char* end, char c);
+
+            /// First char in [begin, end) that is not a token char of
+            /// RFC 7230 (tchar), or @c end if all of them are.
+            const char* findNonToken(const char* begin, const char* end);
+
+            /// The implementation in use.
+            Impl impl();
+            const char* implName(Impl impl);
+
+            /// Switches the implementation, e.g. for benchmarks.
+            /// @return false if the CPU does not support it.
+            /// Not thread safe, call before scanning.
+            bool setImpl(Impl impl);
+
+        } // namespace scan
+
+    } // namespace net
+
+} // namespace muduo
+
+#endif  // MUDUO_NET_CHARSCAN_H
@@ -0,0 +1,78 @@
+#include <WebServer/net/ConnectionPool.h>
+
+#include <WebServer/net/Buffer.h>
+
+#include <new>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t ConnectionPool::kObjectSize;
+const int    ConnectionPool::kObjectsPerSlab;
+const size_t ConnectionPool::kMaxSpareStorage;
+const size_t ConnectionPool::kMaxRecycledCapacity;
+
+ConnectionPool::ConnectionPool()
+    : objects_(kObjectSize, kObjectsPerSlab),
+      numRecycled_(0)
+{
+    spareStorage_.reserve(kMaxSpareStorage);// 之后push_back不会再分配
+}
+
+void* ConnectionPool::allocate(size_t size)
+{
+    if (size <= kObjectSize) {
+        return objects_.allocate();
+    }
+    return ::operator new(size);
+}
+
+void ConnectionPool::deallocate(void* p, size_t size)
+{
+    if (size <= kObjectSize) {
+        objects_.deallocate(static_cast<char*>(p));
+    }
+    else {
+        ::operator delete(p);
+    }
+}
+
+void ConnectionPool::initBuffer(Buffer* buf)
+{
+    std::vector<char> storage;
+    {
+        MutexLockGuard lock(mutex_);
+        if (!spareStorage_.empty()) {
+            storage.swap(spareStorage_.back());
+            spareStorage_.pop_back();
+            ++numRecycled_;
+        }
+    }
+    buf->takeStorage(&storage);// storage为空时分配新的
+}
+
+void ConnectionPool::recycleBuffer(Buffer* buf)
+{
+    std::vector<char> storage;
+    buf->releaseStorage(&storage);
+    if (storage.capacity() > kMaxRecycledCapacity) {
+        return;// 析构storage，释放内存
+    }
+    MutexLockGuard lock(mutex_);
+    if (spareStorage_.size() < kMaxSpareStorage) {
+        spareStorage_.push_back(std::vector<char>());
+        spareStorage_.back().swap(storage);
+    }
+}
+
+size_t ConnectionPool::numSpareStorage() const
+{
+    MutexLockGuard lock(mutex_);
+    return spareStorage_.size();
+}
+
+size_t ConnectionPool::numRecycled() const
+{
+    MutexLockGuard lock(mutex_);
+    return numRecycled_;
+}
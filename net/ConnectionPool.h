@@ -0,0 +1,115 @@
+/*
+ConnectionPool：每个EventLoop一个，回收TcpConnection用到的内存
+- TcpConnection对象（内嵌Socket、Channel和两个缓冲区）与shared_ptr的控制块
+  通过boost::allocate_shared一次分配，内存来自定长block池
+- 连接析构后inputBuffer_的存储（vector<char>）留在池中，给下一个连接用
+- 稳定的连接建立/断开过程中不再调用malloc
+- 连接可能在任意线程析构，所以用mutex保护，实际上几乎没有竞争
+*/
+
+#ifndef MUDUO_NET_CONNECTIONPOOL_H
+#define MUDUO_NET_CONNECTIONPOOL_H
+
+#include <WebServer/base/Mutex.h>
+#include <WebServer/net/BlockPool.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <new>
+#include <vector>
+
+#include <stddef.h>
+
+namespace muduo
+{
+    namespace net
+    {
+        class Buffer;
+
+        ///
+        /// Per-loop recycling pool for connection objects and their buffers.
+        ///
+        class ConnectionPool : boost::noncopyable
+        {
+        private:
+            BlockPool objects_;     // TcpConnection（连同控制块）的内存
+            mutable MutexLock mutex_;
+            std::vector<std::vector<char> > spareStorage_;  // 回收的缓冲区存储
+            size_t numRecycled_;    // 复用了回收存储的次数，guarded by mutex_
+
+        public:
+            static const size_t kObjectSize = 2048;         // 大于这个的对象直接用operator new
+            static const int    kObjectsPerSlab = 32;
+            static const size_t kMaxSpareStorage = 1024;    // 最多保留多少个回收的存储
+            static const size_t kMaxRecycledCapacity = 64 * 1024;// 太大的存储直接释放，不占着内存
+
+            ConnectionPool();
+
+            void* allocate(size_t size);
+            void deallocate(void* p, size_t size);
+
+            /// Gives @c buf recycled storage if there is any, or fresh one.
+            void initBuffer(Buffer* buf);
+            /// Takes back the storage of @c buf, which is about to be destroyed.
+            void recycleBuffer(Buffer* buf);
+
+            size_t numObjectsInUse() const { return objects_.numInUse(); }
+            size_t numSpareStorage() const;
+            size_t numRecycled() const;
+
+        }; // class ConnectionPool
+
+        typedef boost::shared_ptr<ConnectionPool> ConnectionPoolPtr;
+
+        ///
+        /// Allocator for boost::allocate_shared, keeps the pool alive.
+        ///
+        template<typename T>
+        class ConnectionAllocator
+        {
+        public:
+            typedef T value_type;
+            typedef T* pointer;
+            typedef const T* const_pointer;
+            typedef T& reference;
+            typedef const T& const_reference;
+            typedef size_t size_type;
+            typedef ptrdiff_t difference_type;
+
+            template<typename U>
+            struct rebind { typedef ConnectionAllocator<U> other; };
+
+            explicit ConnectionAllocator(const ConnectionPoolPtr& pool) : pool_(pool) {}
+            template<typename U>
+            ConnectionAllocator(const ConnectionAllocator<U>& rhs) : pool_(rhs.pool()) {}
+
+            pointer allocate(size_type n, const void* = 0)
+            { return static_cast<pointer>(pool_->allocate(n * sizeof(T))); }
+            void deallocate(pointer p, size_type n)
+            { pool_->deallocate(p, n * sizeof(T)); }
+
+            pointer address(reference x) const { return &x; }
+            const_pointer address(const_reference x) const { return &x; }
+            size_type max_size() const { return static_cast<size_type>(-1) / sizeof(T); }
+            void construct(pointer p, const T& val) { new (p) T(val); }
+            void destroy(pointer p) { p->~T(); }
+
+            const ConnectionPoolPtr& pool() const { return pool_; }
+
+        private:
+            ConnectionPoolPtr pool_;
+        };
+
+        template<typename T, typename U>
+        bool operator==(const ConnectionAllocator<T>& lhs, const ConnectionAllocator<U>& rhs)
+        { return lhs.pool() == rhs.pool(); }
+
+        template<typename T, typename U>
+        bool operator!=(const ConnectionAllocator<T>& lhs, const ConnectionAllocator<U>& rhs)
+        { return lhs.pool() != rhs.pool(); }
+
+    } // namespace net
+
+} // namespace muduo
+
+#endif  // MUDUO_NET_CONNECTIONPOOL_H
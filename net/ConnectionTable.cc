@@ -0,0 +1,109 @@
+#include <WebServer/net/ConnectionTable.h>
+
+#include <assert.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t ConnectionTable::kInitialCapacity;
+
+ConnectionTable::ConnectionTable()
+    : mask_(0),
+      shift_(64),
+      size_(0)
+{
+    rehash(kInitialCapacity);
+}
+
+size_t ConnectionTable::probe(int64_t id) const
+{
+    size_t i = home(id);
+    while (slots_[i].id != 0 && slots_[i].id != id) {
+        i = next(i);
+    }
+    return i;
+}
+
+bool ConnectionTable::insert(int64_t id, const TcpConnectionPtr& conn)
+{
+    assert(id > 0);
+    // 负载因子不超过3/4，保证探测序列很短
+    if ((size_ + 1) * 4 > slots_.size() * 3) {
+        rehash(slots_.size() * 2);
+    }
+    size_t i = probe(id);
+    if (slots_[i].id == id) {
+        return false;
+    }
+    slots_[i].id = id;
+    slots_[i].conn = conn;
+    ++size_;
+    return true;
+}
+
+size_t ConnectionTable::erase(int64_t id)
+{
+    size_t i = probe(id);
+    if (slots_[i].id != id) {
+        return 0;
+    }
+    // backward shift：把后面“本来应该在i或之前”的元素搬到空出来的位置上
+    size_t j = i;
+    for (;;) {
+        j = next(j);
+        if (slots_[j].id == 0) {
+            break;
+        }
+        size_t k = home(slots_[j].id);
+        // k在(i, j]之间（环形）时，j上的元素不能往前搬
+        bool between = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+        if (!between) {
+            slots_[i].id = slots_[j].id;
+            slots_[i].conn.swap(slots_[j].conn);
+            i = j;
+        }
+    }
+    slots_[i].id = 0;
+    slots_[i].conn.reset();
+    --size_;
+    return 1;
+}
+
+TcpConnectionPtr ConnectionTable::find(int64_t id) const
+{
+    size_t i = probe(id);
+    return slots_[i].id == id ? slots_[i].conn : TcpConnectionPtr();
+}
+
+void ConnectionTable::swapOut(std::vector<TcpConnectionPtr>* conns)
+{
+    conns->reserve(conns->size() + size_);
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        if (slots_[i].id != 0) {
+            conns->push_back(TcpConnectionPtr());
+            conns->back().swap(slots_[i].conn);
+            slots_[i].id = 0;
+        }
+    }
+    size_ = 0;
+}
+
+void ConnectionTable::rehash(size_t capacity)
+{
+    assert((capacity & (capacity - 1)) == 0);   // 2的幂
+    std::vector<Slot> old;
+    old.swap(slots_);
+    slots_.resize(capacity);
+    mask_ = capacity - 1;
+    shift_ = 64;
+    for (size_t n = capacity; n > 1; n >>= 1) {
+        --shift_;
+    }
+    for (size_t i = 0; i < old.size(); ++i) {
+        if (old[i].id != 0) {
+            size_t j = probe(old[i].id);
+            slots_[j].id = old[i].id;
+            slots_[j].conn.swap(old[i].conn);
+        }
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ConnectionTable：以连接ID（整数）为键的开放寻址哈希表
+- 线性探测，删除时把后面的元素往回搬（backward shift），没有墓碑
+- 所有槽位在一个连续的数组中，accept/close时不需要分配树节点和字符串
+- 不是线程安全的，TcpServer为每个IO线程准备一个，只在该线程中访问
+*/
+
+#ifndef MUDUO_NET_CONNECTIONTABLE_H
+#define MUDUO_NET_CONNECTIONTABLE_H
+
+#include <WebServer/net/Callbacks.h>
+
+#include <boost/noncopyable.hpp>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace muduo
+{
+    namespace net
+    {
+        ///
+        /// Open-addressing hash table from connection id (> 0) to TcpConnectionPtr.
+        ///
+        class ConnectionTable : boost::noncopyable
+        {
+        private:
+            struct Slot
+            {
+                int64_t id;     // 0表示空槽
+                TcpConnectionPtr conn;
+
+                Slot() : id(0) {}
+            };
+
+            // Fibonacci哈希：同一个IO线程的ID是等差的（轮询分配），直接取低位会聚在一起
+            size_t home(int64_t id) const
+            { return static_cast<size_t>((static_cast<uint64_t>(id) * 0x9E3779B97F4A7C15ULL) >> shift_); }
+            size_t next(size_t i) const { return (i + 1) & mask_; }
+            size_t probe(int64_t id) const; // id所在的槽，或者应该插入的空槽
+            void rehash(size_t capacity);
+
+            std::vector<Slot> slots_;
+            size_t mask_;   // slots_.size() - 1
+            int    shift_;  // 64 - log2(slots_.size())
+            size_t size_;
+
+        public:
+            static const size_t kInitialCapacity = 64;
+
+            ConnectionTable();
+
+            /// @return false if @c id is already there.
+            bool insert(int64_t id, const TcpConnectionPtr& conn);
+            /// @return number of elements erased, 0 or 1.
+            size_t erase(int64_t id);
+            /// @return empty pointer if not found.
+            TcpConnectionPtr find(int64_t id) const;
+
+            size_t size() const { return size_; }
+            bool empty() const { return size_ == 0; }
+            size_t capacity() const { return slots_.size(); }
+
+            /// Moves all connections out into @c conns and empties the table.
+            void swapOut(std::vector<TcpConnectionPtr>* conns);
+
+            /// Calls @c f(conn) on every connection, @c f must not modify the table.
+            template<typename F>
+            void forEach(F f) const
+            {
+                for (size_t i = 0; i < slots_.size(); ++i) {
+                    if (slots_[i].id != 0) {
+                        f(slots_[i].conn);
+                    }
+                }
+            }
+
+        }; // class ConnectionTable
+
+    } // namespace net
+
+} // namespace muduo
+
+#endif  // MUDUO_NET_CONNECTIONTABLE_H
@@ -1,11 +1,17 @@
 #include <WebServer/net/EventLooping.h>
 #include <WebServer/base/Logging.h>
+#include <WebServer/net/BlockPool.h>
 #include <WebServer/net/Channel.h>
+#include <WebServer/net/ConnectionPool.h>
 #include <WebServer/net/Poller.h>
+#include <WebServer/net/ReadSpill.h>
 #include <WebServer/net/TimerQueue.h>
+#include <WebServer/net/TimerWheel.h>
 
 #include <boost/bind.hpp>
 
+#include <algorithm>
+
 #include <signal.h>
 #include <sys/eventfd.h>
 
@@ -18,6 +24,11 @@ namespace // 匿名的名称空间
     __thread EventLoop* t_loopInThisThread = 0;
 
     const int kPollTimeMs = 10000;// 10s
+    const int64_t kBusyWindowUs = 100 * 1000;// 忙碌时间的统计窗口，100ms
+
+    void runFunctor(const EventLoop::Functor& functor) {
+        functor();
+    }
 
     int createEventfd() {
         int evtfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
@@ -56,7 +67,18 @@ EventLoop::EventLoop()
       timerQueue_(new TimerQueue(this)),
       wakeupFd_(createEventfd()),
       wakeupChannel_(new Channel(this, wakeupFd_)),
-      currentActiveChannel_(NULL)
+      currentActiveChannel_(NULL),
+      sleeping_(false),
+      wakeupPending_(false),
+      blockPool_(new BlockPool),
+      readSpill_(new ReadSpill),
+      connectionPool_(new ConnectionPool),
+      busyWindowStart_(Timestamp::now().microSecondsSinceEpoch()),
+      busyInWindow_(0),
+      busyPermille_(0),
+      busyUpdatedAt_(busyWindowStart_),
+      cpu_(-1),
+      numaNode_(-1)
 {
     LOG_TRACE << "EventLoop created " << this << " in thread " << threadId_;
     
@@ -88,7 +110,16 @@ void EventLoop::loop() {    // 事件循环，该函数不能跨线程调用，
     //::poll(NULL, 0, 5*1000);
     while (!quit_) {
         activeChannels_.clear();
-        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        // 先声明将要阻塞，再检查队列：与queueInLoop中“先入队，再检查sleeping_”配对（seq_cst），
+        // 两边至少有一边能看到对方，所以不会出现任务在队列中而loop一直睡眠的情况
+        int timeoutMs = kPollTimeMs;
+        __atomic_store_n(&sleeping_, true, __ATOMIC_SEQ_CST);
+        if (!pendingFunctors_.empty()) {
+            __atomic_store_n(&sleeping_, false, __ATOMIC_RELAXED);
+            timeoutMs = 0;  // 还有任务，只检查一下I/O，不阻塞
+        }
+        pollReturnTime_ = poller_->poll(timeoutMs, &activeChannels_);
+        __atomic_store_n(&sleeping_, false, __ATOMIC_RELAXED);
         // ++iteration_;
         if (Logger::logLevel() <= Logger::TRACE) {
             printActiveChannels();
@@ -104,12 +135,37 @@ void EventLoop::loop() {    // 事件循环，该函数不能跨线程调用，
         currentActiveChannel_ = NULL;// 处理完后
         eventHandling_ = false;
         doPendingFunctors();// 没有反复执行到pendingFunctors为空
+        updateBusyTime(Timestamp::now());
     }
 
     LOG_TRACE << "EventLoop " << this << " stop looping";
     looping_ = false;
 }
 
+// poll返回之后到下一次poll之前都算忙碌
+void EventLoop::updateBusyTime(Timestamp now) {
+    const int64_t nowUs = now.microSecondsSinceEpoch();
+    busyInWindow_ += nowUs - pollReturnTime_.microSecondsSinceEpoch();
+    const int64_t elapsed = nowUs - busyWindowStart_;
+    if (elapsed >= kBusyWindowUs) {
+        // 窗口包括了阻塞在poll中的时间，长时间空闲之后占比自然很小
+        int permille = static_cast<int>(std::min<int64_t>(busyInWindow_ * 1000 / elapsed, 1000));
+        __atomic_store_n(&busyPermille_, permille, __ATOMIC_RELAXED);
+        __atomic_store_n(&busyUpdatedAt_, nowUs, __ATOMIC_RELAXED);
+        busyWindowStart_ = nowUs;
+        busyInWindow_ = 0;
+    }
+}
+
+int EventLoop::busyPermille() const {
+    const int64_t updatedAt = __atomic_load_n(&busyUpdatedAt_, __ATOMIC_RELAXED);
+    if (Timestamp::now().microSecondsSinceEpoch() - updatedAt > 2 * kBusyWindowUs) {
+        // 很久没有完成一次循环：要么一直阻塞在poll中（空闲），要么卡在某个回调中（很忙）
+        return __atomic_load_n(&sleeping_, __ATOMIC_RELAXED) ? 0 : 1000;
+    }
+    return __atomic_load_n(&busyPermille_, __ATOMIC_RELAXED);
+}
+
 // 该函数可以跨线程调用
 void EventLoop::quit() {
     // quit_是bool型，在Linux底下bool型是原子性操作，不需要原子性保护
@@ -134,20 +190,22 @@ void EventLoop::runInLoop(const Functor& cb) {
 
 // 将回调任务添加到队列当中
 void EventLoop::queueInLoop(const Functor& cb) {
+    pendingFunctors_.push(cb);// 无锁入队
+
+    // 只有loop线程将要（或者正在）阻塞在poll中时才需要唤醒，
+    // 并且在它醒来读走eventfd之前，多个线程只写一次。
+    // loop线程自己调用时sleeping_一定为false，下一轮poll前会发现队列非空
+    if (__atomic_load_n(&sleeping_, __ATOMIC_SEQ_CST)
+        && !__atomic_exchange_n(&wakeupPending_, true, __ATOMIC_ACQ_REL))
     {
-        MutexLockGuard lock(mutex_);
-        pendingFunctors_.push_back(cb);
-    }
-    
-    // 调用queueInLoop的线程不是当前IO线程，则需要唤醒
-    // 或者调用queueInLoop的线程是当前IO线程，并且此时正在调用pending functor，需要唤醒？？
-    // 只有当前IO线程的事件回调中调用queueInLoop才不需要唤醒
-    if (!isInLoopThread() || callingPendingFunctors_) {
         wakeup();
     }
 }
 
 TimerId EventLoop::runAt(const Timestamp& time, const TimerCallback& cb) {
+  if (timerWheel_) {
+    return timerWheel_->addTimer(cb, time, 0.0);
+  }
   return timerQueue_->addTimer(cb, time, 0.0);// (，到期时间，非重复)
 }
 
@@ -158,13 +216,29 @@ TimerId EventLoop::runAfter(double delay, const TimerCallback& cb) {
 
 TimerId EventLoop::runEvery(double interval, const TimerCallback& cb) {
   Timestamp time(addTime(Timestamp::now(), interval));
+  if (timerWheel_) {
+    return timerWheel_->addTimer(cb, time, interval);
+  }
   return timerQueue_->addTimer(cb, time, interval);
 }
 
 void EventLoop::cancel(TimerId timerId) {
+  if (timerWheel_) {
+    return timerWheel_->cancel(timerId);
+  }
   return timerQueue_->cancel(timerId);
 }
 
+void EventLoop::enableTimerWheel(double tick) {
+  assertInLoopThread();
+  assert(!timerWheel_);
+  timerWheel_.reset(new TimerWheel(this, tick));
+}
+
+bool EventLoop::supportsEdgeTriggered() const {
+    return poller_->supportsEdgeTriggered();// poller_在构造时确定，之后不再改变
+}
+
 void EventLoop::updateChannel(Channel* channel) {
     assert(channel->ownerLoop() == this);// 操作channel的应当是所属的本对象
     assertInLoopThread();// 在EventLoop线程当中
@@ -203,21 +277,14 @@ void EventLoop::handleRead() {
     if (n != sizeof one) {
         LOG_ERROR << "EventLoop::handleRead() reads " << n << " bytes instead of 8";
     }
+    __atomic_store_n(&wakeupPending_, false, __ATOMIC_RELEASE);// 之后的queueInLoop可以再次唤醒
 }
 
 void EventLoop::doPendingFunctors() {
-    std::vector<Functor> functors;
     callingPendingFunctors_ = true;     // 处于“调用回调任务ing”的状态中
-    {
-        MutexLockGuard lock(mutex_);    // 保护临界区（只保护这两行内的临界区）
-        functors.swap(pendingFunctors_);// 把回调列表swap到functors中
-        // 这样做一方面减小了临界区的长度，意味着不会阻塞其他线程的queueInLoop()
-        // 另一方面，避免了死锁，因为Functor可能再次调用queueInLoop()
-    }
-
-    for (size_t i = 0; i < functors.size(); ++i) {
-        functors[i]();
-    }
+    // 只执行本次调用之前入队的任务，Functor中再次queueInLoop()的任务留到下一轮，
+    // 消费者只有loop线程一个，不需要加锁
+    pendingFunctors_.consume(runFunctor);
     callingPendingFunctors_ = false;    // 结束“调用回调任务”的状态
 }
 // 没有反复执行到pendingFunctors为空，这是有意的，否则IO线程可能陷入死循环，无法处理IO事件。
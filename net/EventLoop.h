@@ -8,17 +8,24 @@
 #define MUDUO_NET_EVENTLOOP_H
 
 #include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
 
+#include <WebServer/base/Atomic.h>
 #include <muduo/base/CurrentThread.h>
+#include <WebServer/base/MpscQueue.h>
 #include <muduo/base/Thread.h>
 
 namespace muduo
 {
     namespace net
     {
+        class BlockPool;
         class Channel;
+        class ConnectionPool;
         class Poller;
+        class ReadSpill;
         Class TimerQueue;
+        class TimerWheel;
         
         // EventLoop就是Reactor模式的封装，one per thread at most
         class EventLoop : boost::noncopyable
@@ -26,6 +33,8 @@ namespace muduo
         private:
             void abortNotInLoopThread();
             void handleRead();// waked up
+            void doPendingFunctors();
+            void updateBusyTime(Timestamp now);
 
             void printActiveChannels() const;
 
@@ -41,13 +50,27 @@ namespace muduo
             Timestamp pollReturnTime_;// 调用pool()函数时所返回的时间
             boost::scoped_ptr<Poller> poller_;// poller的生存期由EventLoop来控制
             boost::scoped_ptr<TimeQueue> timerQueue_;
+            boost::scoped_ptr<TimerWheel> timerWheel_;// 非空时所有定时器都由时间轮管理
             int wakeupFd_;// 用于eventfd(create a file descriptor for event notification)
             
             boost::scoped_ptr<Channel> wakeupChannel_;// 该通道将会纳入poller_来管理，wakeupChannel_的生存期由EventLoop控制
             ChannelList activeChannels_;    // Poller返回的活动通道
             Channel* currentActiveChannel_; // 当前正在处理的活动通道
-            MutexLock mutex_;
-            std::vector<Functor> pendingFunctors_;
+            MpscQueue<Functor> pendingFunctors_;// 无锁队列，其它线程queueInLoop时不再加锁
+            bool sleeping_;         // loop线程是否将要（或正在）阻塞在poll中; atomic
+            bool wakeupPending_;    // 是否已经写了wakeupFd_但还没有被读走; atomic
+            boost::shared_ptr<BlockPool> blockPool_;// 本IO线程的ChainBuffer都从这个slab池中取block
+            boost::scoped_ptr<ReadSpill> readSpill_;// 本IO线程所有连接共用的读溢出区
+            boost::shared_ptr<ConnectionPool> connectionPool_;// 本IO线程的TcpConnection对象和缓冲区存储从这里分配
+
+            // 负载统计，供EventLoopThreadPool选择IO线程
+            AtomicInt32 numConnections_;    // 属于本loop的TcpConnection个数
+            int64_t busyWindowStart_;       // 当前统计窗口的开始时间（微秒），只在loop线程中访问
+            int64_t busyInWindow_;          // 当前窗口中处理事件和任务所用的时间（微秒），只在loop线程中访问
+            int busyPermille_;              // 上一个窗口的忙碌时间占比（千分比）; atomic
+            int64_t busyUpdatedAt_;         // busyPermille_的更新时间（微秒）; atomic
+            int cpu_;                       // 绑定的CPU，-1表示没有绑定
+            int numaNode_;                  // 所在的NUMA节点，-1表示未知
 
         public：
             typedef boost::function<void()> Functor;
@@ -63,6 +86,19 @@ namespace muduo
 
             void quit();
 
+            /// Runs callback immediately in the loop thread.
+            /// It wakes up the loop, and run the cb.
+            /// If in the same loop thread, cb is run within the function.
+            /// Safe to call from other threads.
+            void runInLoop(const Functor& cb);
+            /// Queues callback in the loop thread.
+            /// Runs after finish pooling.
+            /// Safe to call from other threads, lock-free, the eventfd is
+            /// written only if the loop is about to block in poll.
+            void queueInLoop(const Functor& cb);
+
+            void wakeup();
+
             ///
             /// Time when poll returns, usually means data arrival.
             ///
@@ -95,9 +131,54 @@ namespace muduo
             ///
             void cancel(TimerId timerId);
 
+            ///
+            /// Manages the timers of this loop with a hierarchical timing wheel
+            /// of @c tick seconds resolution, instead of the TimerQueue.
+            /// Add and cancel become O(1), timers may fire up to one tick late.
+            /// Must be called in the loop thread before any timer is added,
+            /// e.g. from the ThreadInitCallback.
+            ///
+            void enableTimerWheel(double tick = 0.001);
+
+            /// Slab pool shared by the ChainBuffers of this loop.
+            /// Blocks may be given back from any thread.
+            const boost::shared_ptr<BlockPool>& blockPool() const { return blockPool_; }
+
+            /// Recycling pool for the TcpConnections of this loop.
+            /// Safe to use from other threads.
+            const boost::shared_ptr<ConnectionPool>& connectionPool() const { return connectionPool_; }
+
+            /// Overflow area for Buffer::readFd, shared by the connections of this loop.
+            /// Must be used in the loop thread.
+            ReadSpill* readSpill() { return get_pointer(readSpill_); }
+
+            /// Number of TcpConnections owned by this loop, counted from their
+            /// construction, so that a connection being handed over already counts.
+            /// Safe to call from other threads.
+            int numConnections() { return numConnections_.get(); }
+
+            /// Fraction of the recent wall time (in 1/1000) this loop spent handling
+            /// events and pending functors rather than waiting in poll.
+            /// Safe to call from other threads.
+            int busyPermille() const;
+
+            /// CPU this loop's thread is pinned to, -1 if not pinned.
+            int cpu() const { return cpu_; }
+            /// NUMA node of the loop's thread (where its memory comes from), -1 if unknown.
+            int numaNode() const { return numaNode_; }
+            pid_t threadId() const { return threadId_; }
+
+            /// Whether channels of this loop may use Channel::setEdgeTriggered().
+            /// Safe to call from other threads.
+            bool supportsEdgeTriggered() const;
+
             //internal usage
             void updateChannel(Channel* channel);// 在Poller中添加或者更新通道
             void removeChannel(Channel* channel);// 从Poller中移除通道
+            void connectionAdded() { numConnections_.increment(); }    // TcpConnection构造时，可以跨线程调用
+            void connectionRemoved() { numConnections_.decrement(); }  // TcpConnection::connectDestroyed()时
+            // EventLoopThread在loop对其它线程可见之前设置
+            void setPlacement(int cpu, int numaNode) { cpu_ = cpu; numaNode_ = numaNode; }
 
             void assertInLoopThread() {
                 if (!isInLoopThread()) {
@@ -1,19 +1,51 @@
 #include <WebServer/net/EventLoopThread.h>
 
+#include <WebServer/base/Logging.h>
 #include <WebServer/net/EventLoop.h>
 
 #include <boost/bind.hpp>
 
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
 using namespace muduo;
 using namespace muduo::net;
 
-EventLoopThread::EventLoopThread(const ThreadInitCallback& cb)
+namespace
+{
+    // 绑定当前线程到cpu，返回是否成功
+    bool pinCurrentThread(int cpu)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (::sched_setaffinity(0, sizeof set, &set) < 0) {// 0表示调用线程
+            LOG_SYSERR << "sched_setaffinity " << cpu;
+            return false;
+        }
+        return true;
+    }
+
+    // 当前线程所在的NUMA节点，没有NUMA时为0
+    int currentNumaNode()
+    {
+        unsigned cpu = 0, node = 0;
+        if (::syscall(SYS_getcpu, &cpu, &node, NULL) < 0) {
+            return -1;
+        }
+        return static_cast<int>(node);
+    }
+}
+
+EventLoopThread::EventLoopThread(const ThreadInitCallback& cb, int cpu)
     : loop_(NULL),
       exiting_(false),
       thread_(boost::bind(&EventLoopThread::threadFunc, this)),
       mutex_(),
       cond_(mutex_),// 条件变量和互斥量配合使用
-      callback_(cb)
+      callback_(cb),
+      cpu_(cpu)
 {
 
 }
@@ -38,7 +70,11 @@ EventLoopThread::EventLoop* startLoop() {// 启动线程，该线程就成为了
 }
 
 void EventLoopThread::threadFunc() {// 线程函数，会在线程中创建一个EventLoop对象
+    // 先绑定CPU再创建EventLoop：BlockPool、ReadSpill等内存都由本线程首次访问，
+    // 按照Linux的first-touch策略分配在本地NUMA节点上
+    const bool pinned = cpu_ >= 0 && pinCurrentThread(cpu_);
     EventLoop loop;
+    loop.setPlacement(pinned ? cpu_ : -1, currentNumaNode());
 
     if (callback_) {
         callback_(&loop);
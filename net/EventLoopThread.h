@@ -33,11 +33,15 @@ namespace muduo
             MutexLock mutex_;// 互斥量
             Condition cond_;// 条件变量
             ThreadInitCallback callback_;// 回调函数，在EventLoop::loop事件循环之前被调用
+            const int cpu_;// 线程绑定的CPU，-1表示不绑定
 
         public:
             typedef boost::function<void(EventLoop*)> ThreadInitCallback;// 默认是一个空的回调函数
 
-            EventLoopThread(const ThreadInitCallback& cb = ThreadInitCallback());
+            /// @param cpu pin the thread to this CPU before the EventLoop is created,
+            /// so that the loop's memory is first touched on the local NUMA node.
+            /// -1 leaves the placement to the scheduler.
+            EventLoopThread(const ThreadInitCallback& cb = ThreadInitCallback(), int cpu = -1);
             ~EventLoopThread();
             EventLoop* startLoop();// 启动线程，该线程就成为了IO线程
         };
@@ -2,17 +2,97 @@
 
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/EventLoopThread.h>
+#include <WebServer/net/Endian.h>
+#include <WebServer/net/InetAddress.h>
 
 #include <boost/bind.hpp>
 
+#include <map>
+
+#include <ctype.h>
+#include <dirent.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+    // 从sysfs中找cpu所属的NUMA节点（目录/sys/devices/system/cpu/cpuN/下的nodeM），
+    // 没有NUMA（或者没有sysfs）时都算节点0
+    int numaNodeOfCpu(int cpu)
+    {
+        char path[64];
+        snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d", cpu);
+        DIR* dir = ::opendir(path);
+        int node = 0;
+        if (dir != NULL) {
+            struct dirent* ent;
+            while ((ent = ::readdir(dir)) != NULL) {
+                if (strncmp(ent->d_name, "node", 4) == 0 && isdigit(ent->d_name[4])) {
+                    node = atoi(ent->d_name + 4);
+                    break;
+                }
+            }
+            ::closedir(dir);
+        }
+        return node;
+    }
+
+    // 进程允许使用的CPU，按照placement排好序
+    std::vector<int> placeCpus(int placement)
+    {
+        std::vector<int> cpus;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (::sched_getaffinity(0, sizeof set, &set) < 0) {
+            return cpus;
+        }
+        std::map<int, std::vector<int> > nodes;   // <node, cpus>
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                nodes[numaNodeOfCpu(cpu)].push_back(cpu);
+            }
+        }
+
+        if (placement == EventLoopThreadPool::kPinCompact) {
+            for (std::map<int, std::vector<int> >::iterator it = nodes.begin();
+                 it != nodes.end(); ++it)
+            {
+                cpus.insert(cpus.end(), it->second.begin(), it->second.end());
+            }
+        }
+        else {
+            // 每个节点取一个，直到取完
+            for (size_t i = 0; ; ++i) {
+                bool any = false;
+                for (std::map<int, std::vector<int> >::iterator it = nodes.begin();
+                     it != nodes.end(); ++it)
+                {
+                    if (i < it->second.size()) {
+                        cpus.push_back(it->second[i]);
+                        any = true;
+                    }
+                }
+                if (!any) {
+                    break;
+                }
+            }
+        }
+        return cpus;
+    }
+}
+
 EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseLoop)
     : baseLoop_(baseLoop),
       started_(false),
       numThreads_(0),
-      next_(0)
+      next_(0),
+      policy_(kRoundRobin),
+      placement_(kNoPinning)
 {
 }
 
@@ -28,8 +108,13 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb)
 
     started_ = true;
 
+    if (cpus_.empty() && placement_ != kNoPinning) {
+        cpus_ = placeCpus(placement_);
+    }
+
     for (int i = 0; i < numThreads_; ++i) {
-        EventLoopThread* t = new EventLoopThread(cb);
+        int cpu = cpus_.empty() ? -1 : cpus_[i % cpus_.size()];
+        EventLoopThread* t = new EventLoopThread(cb, cpu);
         threads_.push_back(t);
         loops_.push_back(t->startLoop());// 启动EventLoopThread线程，在进入事件循环之前，会调用cb
     }
@@ -47,6 +132,9 @@ EventLoop* EventLoopThreadPool::getNextLoop()
     // 如果loops_为空，则loop指向baseLoop_
     // 如果不为空。按照round-robin（RR，轮询）的调度方式选择一个EventLoop
     if (!loops_.empty()) {
+        if (policy_ == kLeastConnections || policy_ == kLeastBusy) {
+            return getLeastLoadedLoop();
+        }
         // round-robin
         loop = loops_[next_];
         ++next_;
@@ -54,4 +142,55 @@ EventLoop* EventLoopThreadPool::getNextLoop()
             next_ = 0;
     }
     return loop;
-}
\ No newline at end of file
+}
+
+EventLoop* EventLoopThreadPool::getNextLoop(const InetAddress& peerAddr)
+{
+    baseLoop_->assertInLoopThread();
+    if (policy_ == kPeerHash && !loops_.empty()) {
+        // 只用IP不用端口：重连时端口会变
+        uint32_t hash = sockets::networkToHost32(peerAddr.ipNetEndian());
+        // murmur3的fmix32，每一位都影响低位，同一网段的地址也能分散到各个loop
+        hash ^= hash >> 16;
+        hash *= 0x85ebca6bu;
+        hash ^= hash >> 13;
+        hash *= 0xc2b2ae35u;
+        hash ^= hash >> 16;
+        return loops_[hash % loops_.size()];
+    }
+    return getNextLoop();
+}
+
+// 负载是各个IO线程自己更新的，这里读到的只是近似值，够用了
+EventLoop* EventLoopThreadPool::getLeastLoadedLoop()
+{
+    // 从next_开始找，负载相同时也能轮流分配
+    const size_t n = loops_.size();
+    size_t best = next_;
+    int bestBusy = policy_ == kLeastBusy ? loops_[best]->busyPermille() : 0;
+    int bestConns = loops_[best]->numConnections();
+    for (size_t i = 1; i < n; ++i) {
+        size_t idx = (next_ + i) % n;
+        int busy = policy_ == kLeastBusy ? loops_[idx]->busyPermille() : 0;
+        int conns = loops_[idx]->numConnections();
+        if (busy < bestBusy || (busy == bestBusy && conns < bestConns)) {
+            best = idx;
+            bestBusy = busy;
+            bestConns = conns;
+        }
+    }
+    next_ = static_cast<int>((best + 1) % n);
+    return loops_[best];
+}
+
+std::vector<EventLoop*> EventLoopThreadPool::getAllLoops()
+{
+    baseLoop_->assertInLoopThread();
+    assert(started_);
+    if (loops_.empty()) {
+        return std::vector<EventLoop*>(1, baseLoop_);
+    }
+    else {
+        return loops_;
+    }
+}
@@ -17,6 +17,7 @@ namespace muduo
     {
         class EventLoop;
         class EventLoopThread;
+        class InetAddress;
 
         class EventLoopThreadPool : boost::noncopyable
         {
@@ -25,19 +26,64 @@ namespace muduo
             bool started_;       // 是否启动 
             int  numThreads_;    // 线程数
             int  next_;          // 新连接到来，所选择的EventLoop对象的下标
+            int  policy_;        // DispatchPolicy
+            int  placement_;     // Placement
+            std::vector<int> cpus_;// 第i个IO线程绑定到cpus_[i % cpus_.size()]
             boost::ptr_vector<EventLoopThread> threads_;    // IO线程列表
             // ptr_vector对象threads_销毁时，所管理的EventLoopThread对象也会销毁
             std::vector<EventLoop*>            loops_;      // EventLoop列表
             // 一个IO线程对应一个EventLoop对象，都在栈上，不需要我们销毁
 
+            EventLoop* getLeastLoadedLoop();
+            
         public:
             typedef boost::function<void(EventLoop*)> ThreadInitCallback;
 
+            /// How getNextLoop() picks a loop for a new connection.
+            enum DispatchPolicy
+            {
+                kRoundRobin,        // 轮询（默认）
+                kLeastConnections,  // EventLoop::numConnections()最小的
+                kLeastBusy,         // EventLoop::busyPermille()最小的，相同时比较连接数
+                kPeerHash,          // 按对端IP哈希，同一个客户端重连时落在同一个loop
+            };
+
             EventLoopThreadPool(EventLoop* baseLoop);
             ~EventLoopThreadPool();
             void setThreadNum(int numThreads) { numThreads_ = numThreads; }
             void start(const ThreadInitCallback& cb = ThreadInitCallback());
+            /// Where the IO threads run, the base loop is never pinned.
+            enum Placement
+            {
+                kNoPinning,         // 由调度器决定（默认）
+                kPinCompact,        // 依次绑定到允许的CPU上，先占满一个NUMA节点
+                kPinSpreadNodes,    // 轮流绑定到各个NUMA节点的CPU上
+            };
+
+            /// Must be called before start
+            void setPlacement(Placement placement) { placement_ = placement; }
+            /// Pins the i-th IO thread to cpus[i % cpus.size()], overrides setPlacement().
+            /// Must be called before start
+            void setCpuSet(const std::vector<int>& cpus) { cpus_ = cpus; }
+
+            /// Must be called before start
+            void setDispatchPolicy(DispatchPolicy policy) { policy_ = policy; }
+            DispatchPolicy dispatchPolicy() const { return static_cast<DispatchPolicy>(policy_); }
+
+            /// Picks a loop according to the dispatch policy,
+            /// kPeerHash falls back to round-robin as there is no peer.
             EventLoop* getNextLoop();
+            /// Picks a loop for a connection from @c peerAddr.
+            EventLoop* getNextLoop(const InetAddress& peerAddr);
+
+            /// All IO loops, or the base loop if there is no thread.
+            /// Valid after start().
+            std::vector<EventLoop*> getAllLoops();
+
+            /// Same as getAllLoops(), but safe to call from other threads once
+            /// start() has returned, e.g. from the Inspector.
+            std::vector<EventLoop*> loops() const
+            { return loops_.empty() ? std::vector<EventLoop*>(1, baseLoop_) : loops_; }
         
         };// class EventLoopThreadPool
     } // namespace net
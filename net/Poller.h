@@ -36,6 +36,9 @@ namespace muduo
             /// Must be called in the loop thread.
             virtual void removeChannel(Channel* channel) = 0;
 
+            /// Whether Channel::setEdgeTriggered() is honored.
+            virtual bool supportsEdgeTriggered() const { return false; }
+
             static Poller* newDefaultPoller(EventLoop* loop);
 
             void assertInLoopThread() {
@@ -0,0 +1,66 @@
+/*
+ReadSpill：每个EventLoop一块的读溢出区
+- Buffer::readFd用readv读数据，第二块缓冲区原来是栈上的64K数组，每次调用都要碰一遍新的栈
+- 同一个IO线程中的所有连接是串行读的，所以可以共用一块溢出区，只在构造EventLoop时分配一次
+- 同时统计读的次数、溢出的次数和溢出的字节数，用来判断Buffer的预测是否合适
+*/
+
+#ifndef MUDUO_NET_READSPILL_H
+#define MUDUO_NET_READSPILL_H
+
+#include <boost/noncopyable.hpp>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace muduo
+{
+    namespace net
+    {
+        ///
+        /// Spill area shared by all reads of one EventLoop.
+        ///
+        /// Must be used in the loop thread only. Counters are plain integers
+        /// written by the loop thread, other threads may read them approximately.
+        class ReadSpill : boost::noncopyable
+        {
+        private:
+            std::vector<char> area_;
+            int64_t numReads_;          // readFd调用次数
+            int64_t numOverflows_;      // 数据溢出到spill区的次数（需要append拷贝）
+            int64_t overflowBytes_;     // 溢出的总字节数
+
+        public:
+            static const size_t kDefaultSize = 64 * 1024;
+
+            explicit ReadSpill(size_t size = kDefaultSize)
+                : area_(size),
+                  numReads_(0),
+                  numOverflows_(0),
+                  overflowBytes_(0)
+            {}
+
+            char* data() { return &*area_.begin(); }
+            size_t size() const { return area_.size(); }
+
+            void record(size_t overflow)
+            {
+                ++numReads_;
+                if (overflow > 0) {
+                    ++numOverflows_;
+                    overflowBytes_ += overflow;
+                }
+            }
+
+            int64_t numReads() const { return numReads_; }
+            int64_t numOverflows() const { return numOverflows_; }
+            int64_t overflowBytes() const { return overflowBytes_; }
+
+        }; // class ReadSpill
+
+    } // namespace net
+
+} // namespace muduo
+
+#endif  // MUDUO_NET_READSPILL_H
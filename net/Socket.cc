@@ -1,5 +1,6 @@
 #include <WebServer/net/Socket.h>
 
+#include <WebServer/base/Logging.h>
 #include <WebServer/net/InetAddress.h>
 #include <WebServer/net/SocketsOps.h>
 
@@ -58,6 +59,16 @@ void Socket::setReuseAddr(bool on)
   // FIXME CHECK
 }
 
+void Socket::setReusePort(bool on)
+{
+    int optval = on ? 1 : 0;
+    int ret = ::setsockopt(sockfd_, SOL_SOCKET, SO_REUSEPORT,
+                           &optval, sizeof optval);
+    if (ret < 0 && on) {
+        LOG_SYSERR << "SO_REUSEPORT failed.";
+    }
+}
+
 void Socket::setKeepAlive(bool on)
 {
     int optval = on ? 1 : 0;
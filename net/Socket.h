@@ -63,6 +63,12 @@ namespace muduo
             // 设置地址重复利用
             void setReuseAddr(bool on);
 
+            ///
+            /// Enable/disable SO_REUSEPORT
+            ///
+            // 多个socket可以绑定同一个端口，由内核按照四元组哈希把新连接分给各个监听socket
+            void setReusePort(bool on);
+
             ///
             /// Enable/disable SO_KEEPALIVE
             ///
@@ -12,7 +12,9 @@
 #include <fcntl.h>
 #include <stdio.h>      // snprintf
 #include <strings.h>    // bzero
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/uio.h>    // readv, writev
 #include <unistd.h>
 
 using namespace muduo;
@@ -97,7 +99,10 @@ int sockets::accept(int sockfd, struct sockarr_in* addr)
 #endif
     if (connfd < 0) {
         int savedErrno = errno;// 先保存errno值，因为系统调用和库函数可能会改变该值。
-        LOG_SYSERR << "Socket::accept";
+        // 批量accept时EAGAIN表示backlog已经取完，是正常的结束条件，不记录日志
+        if (savedErrno != EAGAIN) {
+            LOG_SYSERR << "Socket::accept";
+        }
         switch (savedErrno)
         { 
         case EAGAIN:
@@ -159,6 +164,18 @@ ssize_t sockets::write(int sockfd, const void *buf, size_t count)
     return ::write(sockfd, buf, count);
 }
 
+// 将多个缓冲区的数据用一次系统调用发送出去（gather write）
+ssize_t sockets::writev(int sockfd, const struct iovec *iov, int iovcnt)
+{
+    return ::writev(sockfd, iov, iovcnt);
+}
+
+// 在内核中直接把文件内容发送到socket，数据不经过用户空间，*offset会被更新
+ssize_t sockets::sendfile(int sockfd, int fileFd, off_t* offset, size_t count)
+{
+    return ::sendfile(sockfd, fileFd, offset, count);
+}
+
 // 关闭文件描述符
 void sockets::close(int sockfd)
 {
@@ -25,6 +25,8 @@ namespace muduo
             ssize_t read(int sockfd, void*buf, size_t count);
             ssize_t readv(int sockfd, const struct iovec *iov, int iovcnt);
             ssize_t write(int sockfd, const void *buf, size_t count);
+            ssize_t writev(int sockfd, const struct iovec *iov, int iovcnt);
+            ssize_t sendfile(int sockfd, int fileFd, off_t* offset, size_t count);
             void    close(int sockfd);
             void    shutdownWrite(int sockfd);
 
@@ -7,13 +7,24 @@
 #include <WebServer/net/SocketsOps.h>
 
 #include <boost/bind.hpp>
+#include <boost/static_assert.hpp>
+
+#include <algorithm>
+#include <utility>    // std::move
 
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>   // IOV_MAX
 #include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>
 
 using namespace muduo;
 using namespace muduo::net;
 
+// TcpServer用allocate_shared从ConnectionPool分配，再加上控制块也要放得进一个block
+BOOST_STATIC_ASSERT(sizeof(TcpConnection) + 128 <= ConnectionPool::kObjectSize);
+
 void muduo::net::defaultConnectionCallback(const TcpConnectionPtr& conn)
 {
     LOG_TRACE << conn->locaAddress().toIpPort() << " -> "
@@ -36,36 +47,97 @@ TcpConnection::TcpConnection(EventLoop* loop,
                           const InetAddress& peerAddr)
     : loop_(CHECK_NOTNULL(loop)),
       name_(nameArg),
+      id_(0),
+      state_(kConnecting),
+      socket_(sockfd),
+      channel_(loop, sockfd),
+      pool_(loop->connectionPool()),
+      localAddr_(localAddr),
+      peerAddr_(peerAddr),
+      highWaterMark_(64*1024*1024),
+      lowWaterMark_(0),
+      throttling_(false),
+      readStopped_(false),
+      readThrottled_(false),
+      inputBuffer_(Buffer::DeferStorage()),// 存储在init()中从pool_取
+      outputBuffer_(loop->blockPool()),   // block来自本IO线程的slab池
+      pendingFileBytes_(0),
+      outputBytesFlushed_(0)
+{
+    init(sockfd);
+}
+
+TcpConnection::TcpConnection(EventLoop* loop,
+                          int64_t id,
+                          const NamePrefixPtr& namePrefix,
+                          int sockfd,
+                          const InetAddress& localAddr,
+                          const InetAddress& peerAddr)
+    : loop_(CHECK_NOTNULL(loop)),
+      id_(id),
+      namePrefix_(namePrefix),
       state_(kConnecting),
-      socket_(new Socket(sockfd)),
-      channel_(new Channel(loop, sockfd)),
+      socket_(sockfd),
+      channel_(loop, sockfd),
+      pool_(loop->connectionPool()),
       localAddr_(localAddr),
-      peerAddr_(peerAddr)
+      peerAddr_(peerAddr),
+      highWaterMark_(64*1024*1024),
+      lowWaterMark_(0),
+      throttling_(false),
+      readStopped_(false),
+      readThrottled_(false),
+      inputBuffer_(Buffer::DeferStorage()),// 存储在init()中从pool_取
+      outputBuffer_(loop->blockPool()),   // block来自本IO线程的slab池
+      pendingFileBytes_(0),
+      outputBytesFlushed_(0)
+{
+    init(sockfd);
+}
+
+string TcpConnection::name() const
+{
+    if (!namePrefix_) {
+        return name_;
+    }
+    char buf[32];
+    snprintf(buf, sizeof buf, "%lld", static_cast<long long>(id_));
+    return *namePrefix_ + buf;
+}
+
+void TcpConnection::init(int sockfd)
 {
+    pool_->initBuffer(&inputBuffer_);// 优先复用已关闭连接的存储
     // 通道可读事件到来的时候，回调TcpConnection::handleRead()，_1是事件发生时间
-    channel_->setReadCallbac (
+    channel_.setReadCallbac (
         boost::bind(&TcpConnection::handleRead, this, _1);
     // 通道可写事件到来的时候，回调TcpConnection::handleWrite
-    channel_->setWriteCallback(
+    channel_.setWriteCallback(
         boost::bind(&TcpConnection::handleWrite, this)); 
     // 连接关闭，回调TcpConnection::handleClose()
-    channel_->setCloseCallback(
+    channel_.setCloseCallback(
         boost::bind(&TcpConnection::handleClose, this));
     // 发生错误，回调TcpConnection::handleError()
-    channel_->setErrorCallback(
+    channel_.setErrorCallback(
         boost::bind(&TcpConnection::handleError, this));
+    loop_->connectionAdded();// 构造时就计入，EventLoopThreadPool选择loop时立即可见
 
-    LOG_DEBUG << "TcpConnection::ctor[" << name_ << "] at" 
+    LOG_DEBUG << "TcpConnection::ctor[" << name() << "] at" 
               << this; << " fd=" << sockfd;
-    socket_->setKeepAlive(true);
+    socket_.setKeepAlive(true);
 }
                           
                           
                           
 TcpConnection::~TcpConnection()
 {
-    LOG_DEBUG << "TcpConnection::dtor[" << name_ << "] at" << this
-              << " fd=" << channel_->fd();
+    LOG_DEBUG << "TcpConnection::dtor[" << name() << "] at" << this
+              << " fd=" << channel_.fd();
+    // 还没发送完的文件段，关闭dup出来的文件描述符
+    for (size_t i = 0; i < pendingFiles_.size(); ++i) {
+        ::close(pendingFiles_[i].fd);
+    }
+    pool_->recycleBuffer(&inputBuffer_);// 存储留给下一个连接
 }
 
 // 线程安全，可以跨线程调用
@@ -75,48 +147,152 @@ void TcpConnection::send(const void* data, size_t len)
         if (loop_->isInLoopThread()) {// 本线程调用
             sendInLoop(data, len);
         }
-        else {// 跨线程调用
-            string message(static_cast<const char*>(data), len);
+        else {// 跨线程调用，拷贝一次到chunk中，之后只传递引用
+            ChunkPtr chunk(new string(static_cast<const char*>(data), len));
             loop_->runInLoop(
-                boost::bind(&TcpConnection::sendInLoop,
-                            this,
-                            message));
+                boost::bind(&TcpConnection::sendChunkInLoop,
+                            shared_from_this(),
+                            chunk));
         }
     }
 }
 
 // 线程安全，可以跨线程调用
-void send(const StringPiece& message)
+void TcpConnection::send(const StringPiece& message)
+{
+    send(message.data(), message.size());
+}
+
+// 线程安全，可以跨线程调用
+void TcpConnection::send(const char* message)
+{
+    send(message, strlen(message));
+}
+
+// 线程安全，可以跨线程调用
+void TcpConnection::send(Buffer* buf)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread()) {
+            sendInLoop(buf->peek(), buf->readableBytes());
+            buf->retrieveAll();
+        }
+        else {// 把数据swap到堆上的Buffer中，不拷贝
+            boost::shared_ptr<Buffer> owned(new Buffer);
+            owned->swap(*buf);
+            copyBytesAvoided_.add(owned->readableBytes());
+            loop_->runInLoop(
+                boost::bind(&TcpConnection::sendBufferInLoop,
+                            shared_from_this(),
+                            owned));
+        }
+    }
+}
+
+#if __cplusplus >= 201103L
+// 线程安全，可以跨线程调用
+void TcpConnection::send(string&& message)
 {
     if (state_ == kConnected) {
-        if (loop_->isInLoopThread()) {// 本线程调用
-            sendInLoop(message);
+        if (loop_->isInLoopThread()) {// 本线程调用，直接写，写不完的部分才拷贝，不用分配chunk
+            sendInLoop(message.data(), message.size());
         }
-        else {// 跨线程调用
+        else {// 原来跨线程时要拷贝一次
+            ChunkPtr chunk(new string(std::move(message)));
+            copyBytesAvoided_.add(chunk->size());
             loop_->runInLoop(
-                boost::bind(&TcpConnection::sendInLoop,
-                            this,
-                            message.as_string()));
-                            //std::forward<string>(message)));
+                boost::bind(&TcpConnection::sendChunkInLoop,
+                            shared_from_this(),
+                            chunk));
         }
     }
 }
 
 // 线程安全，可以跨线程调用
-void TcpConnection::send(Buffer* buf)
+void TcpConnection::send(Buffer&& message)
 {
-    if (state_ == kConnected)
-    {
+    send(&message);
+}
+#endif
+
+// 线程安全，可以跨线程调用
+void TcpConnection::send(const ChunkPtr& chunk)
+{
+    if (state_ == kConnected) {
         if (loop_->isInLoopThread()) {
-        sendInLoop(buf->peek(), buf->readableBytes());
-        buf->retrieveAll();
+            sendChunkInLoop(chunk);
         }
         else {
-        loop_->runInLoop(
-            boost::bind(&TcpConnection::sendInLoop,
-                        this,
-                        buf->retrieveAllAsString()));
-                        //std::forward<string>(message)));
+            copyBytesAvoided_.add(chunk->size());
+            loop_->runInLoop(
+                boost::bind(&TcpConnection::sendChunkInLoop,
+                            shared_from_this(),
+                            chunk));
+        }
+    }
+}
+
+// 线程安全，可以跨线程调用
+void TcpConnection::send(const StringPiece* slices, size_t count)
+{
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {// 本线程调用，slice直接交给writev
+            sendSlicesInLoop(slices, count);
+        }
+        else {// 跨线程调用，slice所指的数据可能在返回后失效，只能拷贝一次
+            std::vector<ChunkPtr> chunks;
+            chunks.reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                chunks.push_back(ChunkPtr(new string(slices[i].data(), slices[i].size())));
+            }
+            loop_->runInLoop(
+                boost::bind(&TcpConnection::sendChunksInLoop,
+                            shared_from_this(),
+                            chunks));
+        }
+    }
+}
+
+// 线程安全，可以跨线程调用
+void TcpConnection::send(const std::vector<ChunkPtr>& chunks)
+{
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendChunksInLoop(chunks);
+        }
+        else {
+            size_t total = 0;
+            for (size_t i = 0; i < chunks.size(); ++i) {
+                total += chunks[i]->size();
+            }
+            copyBytesAvoided_.add(total);
+            loop_->runInLoop(
+                boost::bind(&TcpConnection::sendChunksInLoop,
+                            shared_from_this(),
+                            chunks));
+        }
+    }
+}
+
+// 线程安全，可以跨线程调用
+void TcpConnection::sendFile(int fd, off_t offset, size_t len)
+{
+    if (state_ == kConnected && len > 0) {
+        // dup一份，调用者可以马上关闭自己的fd，发送完毕后由TcpConnection关闭
+        int dupFd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (dupFd < 0) {
+            LOG_SYSERR << "TcpConnection::sendFile";
+            return;
+        }
+        if (loop_->isInLoopThread()) {
+            sendFileInLoop(dupFd, offset, len);
+        }
+        else {
+            loop_->runInLoop(
+                boost::bind(&TcpConnection::sendFileInLoop,
+                            shared_from_this(),// 连接在执行之前析构，dupFd就没有人关闭了
+                            dupFd, offset, len));
         }
     }
 }
@@ -129,43 +305,358 @@ void TcpConnection::sendInLoop(const StringPiece& message)
 void TcpConnection::sendInLoop(const void* data, size_t len)
 {
     loop_->assertInLoopThread();
-    // sockets::write(channel_->fd(), data, len);
     ssize_t nwrote = 0;
     size_t remaining = len;
-    bool error = false;
+    bool faultError = false;
     if (state_ == kDisconnected) {
         LOG_WARN << "disconnected, give up writing";
         return;
     }
     // if no thing in output queue, try writing directly
     // 通道没有关注可写事件并且发送缓冲区没有数据，直接write
-    if (!channel_->isWriting() && outputbuffer_.reableBytes() == 0) {
-        nwrote = sockets::write(channel_->fd(), data, len);
-        if (nwrote >= 0) {
-            remaining = len - nwrote;
-            if (remaining == 0 && writeCompleteCallback_) {// 写完了，回调writeCompleteCallback_
-                loop_->queueInLoop(boost::bind(writeCompleteCallback_, shared_from_this()));
+    if (!channel_.isWriting() && outputBuffer_.readableBytes() == 0) {
+        struct iovec vec;
+        vec.iov_base = const_cast<void*>(data);
+        vec.iov_len = len;
+        nwrote = writeDirectly(&vec, 1, len, &faultError);
+        remaining = len - nwrote;
+    }
+    assert(remaining <= len);
+    if (!faultError && remaining > 0) { // 没有错误，并且还有没写完的数据（说明内核发送缓冲区满，要将未写完的数据添加到output buffer中）
+        LOG_TRACE << "I am going to write more data.";
+        size_t oldLen = pendingOutputBytes();// 目前output buffer中的数据
+        outputBuffer_.append(static_cast<const char*>(data)+nwrote, remaining);// 写入起始的位置为data偏移nwrote后，长度为remaining
+        checkHighWaterMark(oldLen);
+        if (!channel_.isWriting()) {
+            channel_.enableWriting(); // 关注POLLOUT事件
+        }
+    }
+}
+
+void TcpConnection::sendSlicesInLoop(const StringPiece* slices, size_t count)
+{
+    loop_->assertInLoopThread();
+    if (state_ == kDisconnected) {
+        LOG_WARN << "disconnected, give up writing";
+        return;
+    }
+    size_t nwrote = 0;
+    bool faultError = false;
+    if (!channel_.isWriting() && outputBuffer_.readableBytes() == 0) {
+        // 一次writev最多IOV_MAX个slice，剩下的直接进入output buffer
+        struct iovec vec[IOV_MAX];
+        int iovcnt = 0;
+        size_t total = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (iovcnt < IOV_MAX) {
+                vec[iovcnt].iov_base = const_cast<char*>(slices[i].data());
+                vec[iovcnt].iov_len = slices[i].size();
+                ++iovcnt;
             }
+            total += slices[i].size();
         }
+        nwrote = writeDirectly(vec, iovcnt, total, &faultError);
     }
-    assert(remaining <= len);
-    if (!error &&  remaining > 0) { // 没有错误，并且还有没写完的数据（说明内核发送缓冲区满，要将未写完的数据添加到output buffer中）
-        LOG_TRACE << "I am going to write more data."
-        size_t oldLEN = outputBuffer_.readableBytes();// 目前output buffer中的数据
-        // 如果超过highWaterMark_（高水位标），回调highWaterMarkCallback_
-        if (oldLen + remaining >= highWaterMark_
-            && oldLen < highWaterMark_
-            && highWaterMarkCallback_)
-        {
-            loop_->queueInLoop(boost::bind(highWaterMarkCallback_, 
-                                           shared_from_this(), 
-                                           oldLen + remaining));
+    if (faultError) {
+        return;
+    }
+    // 跳过已经写出的部分，其余的拷贝到output buffer
+    size_t oldLen = pendingOutputBytes();
+    for (size_t i = 0; i < count; ++i) {
+        size_t len = slices[i].size();
+        if (nwrote >= len) {
+            nwrote -= len;
+            continue;
         }
-        outputBuffer_.append(static_cast<const char*>(data)+nwrote, remaining);// 写入起始的位置为data偏移nwrote后，长度为remaining
-        if (!channel_->isWriting()) {
-            channel_->enableWriting(); // 关注POLLOUT事件
+        outputBuffer_.append(slices[i].data() + nwrote, len - nwrote);
+        nwrote = 0;
+    }
+    if (pendingOutputBytes() > oldLen) {
+        checkHighWaterMark(oldLen);
+        if (!channel_.isWriting()) {
+            channel_.enableWriting();
+        }
+    }
+}
+
+void TcpConnection::sendChunksInLoop(const std::vector<ChunkPtr>& chunks)
+{
+    if (!chunks.empty()) {
+        sendChunkArrayInLoop(&chunks[0], chunks.size());
+    }
+}
+
+void TcpConnection::sendChunkInLoop(const ChunkPtr& chunk)
+{
+    sendChunkArrayInLoop(&chunk, 1);
+}
+
+void TcpConnection::sendBufferInLoop(const boost::shared_ptr<Buffer>& buf)
+{
+    sendInLoop(buf->peek(), buf->readableBytes());
+}
+
+void TcpConnection::sendChunkArrayInLoop(const ChunkPtr* chunks, size_t count)
+{
+    loop_->assertInLoopThread();
+    if (state_ == kDisconnected) {
+        LOG_WARN << "disconnected, give up writing";
+        return;
+    }
+    size_t nwrote = 0;
+    bool faultError = false;
+    if (!channel_.isWriting() && outputBuffer_.readableBytes() == 0) {
+        struct iovec vec[IOV_MAX];
+        int iovcnt = 0;
+        size_t total = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (iovcnt < IOV_MAX) {
+                vec[iovcnt].iov_base = const_cast<char*>(chunks[i]->data());
+                vec[iovcnt].iov_len = chunks[i]->size();
+                ++iovcnt;
+            }
+            total += chunks[i]->size();
+        }
+        nwrote = writeDirectly(vec, iovcnt, total, &faultError);
+    }
+    if (faultError) {
+        return;
+    }
+    // 剩下的chunk按引用挂到output buffer上，不拷贝
+    size_t oldLen = pendingOutputBytes();
+    for (size_t i = 0; i < count; ++i) {
+        size_t len = chunks[i]->size();
+        if (nwrote >= len) {
+            nwrote -= len;
+            continue;
+        }
+        outputBuffer_.append(chunks[i], nwrote);
+        nwrote = 0;
+    }
+    if (pendingOutputBytes() > oldLen) {
+        checkHighWaterMark(oldLen);
+        if (!channel_.isWriting()) {
+            channel_.enableWriting();
+        }
+    }
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t len)
+{
+    loop_->assertInLoopThread();
+    if (state_ == kDisconnected) {
+        LOG_WARN << "disconnected, give up sending file";
+        ::close(fd);
+        return;
+    }
+    // 前面没有排队的数据，直接sendfile
+    if (!channel_.isWriting() && outputBuffer_.readableBytes() == 0) {
+        ssize_t n = sockets::sendfile(channel_.fd(), fd, &offset, len);
+        if (n >= 0) {
+            len -= n;
+            if (len == 0) {
+                ::close(fd);
+                if (writeCompleteCallback_) {
+                    loop_->queueInLoop(boost::bind(writeCompleteCallback_, shared_from_this()));
+                }
+                return;
+            }
+        }
+        else if (errno != EWOULDBLOCK) {
+            LOG_SYSERR << "TcpConnection::sendFileInLoop";
+            if (errno == EPIPE || errno == ECONNRESET) {
+                ::close(fd);
+                return;
+            }
         }
     }
+    // 排到outputBuffer_中已有的数据之后
+    size_t oldLen = pendingOutputBytes();
+    FileSegment file;
+    file.fd = fd;
+    file.offset = offset;
+    file.remaining = len;
+    file.streamPos = outputBytesFlushed_ + outputBuffer_.readableBytes();
+    pendingFiles_.push_back(file);
+    pendingFileBytes_ += len;
+    checkHighWaterMark(oldLen);
+    if (!channel_.isWriting()) {
+        channel_.enableWriting();
+    }
+}
+
+// 按顺序写出待发送的数据：outputBuffer_中排在第一个文件段之前的部分用writev，
+// 轮到文件段时用sendfile。每次只调用一次系统调用，LT模式下下次可写时再继续，
+// 边沿触发时由handleWrite循环调用
+ssize_t TcpConnection::writePending(int* savedErrno)
+{
+    if (pendingFiles_.empty()) {
+        ssize_t n = outputBuffer_.writeFd(channel_.fd(), savedErrno);
+        if (n > 0) {
+            outputBytesFlushed_ += n;
+        }
+        return n;
+    }
+
+    FileSegment& file = pendingFiles_.front();
+    assert(file.streamPos >= outputBytesFlushed_);
+    size_t before = static_cast<size_t>(file.streamPos - outputBytesFlushed_);
+    if (before > 0) {   // 文件段之前还有缓冲的数据
+        ssize_t n = outputBuffer_.writeFd(channel_.fd(), savedErrno, before);
+        if (n > 0) {
+            outputBytesFlushed_ += n;
+        }
+        return n;
+    }
+
+    ssize_t n = sockets::sendfile(channel_.fd(), file.fd, &file.offset, file.remaining);
+    if (n < 0) {
+        *savedErrno = errno;
+        return n;
+    }
+    if (n == 0) {       // 文件比声明的短，丢弃这个文件段，避免死循环
+        LOG_ERROR << "TcpConnection::writePending [" << name()
+                  << "] - file ended with " << file.remaining << " bytes unsent";
+        n = static_cast<ssize_t>(file.remaining);
+        file.remaining = 0;
+    }
+    else {
+        file.remaining -= n;
+    }
+    pendingFileBytes_ -= std::min(pendingFileBytes_, static_cast<size_t>(n));
+    if (file.remaining == 0) {
+        ::close(file.fd);
+        pendingFiles_.pop_front();
+    }
+    return n;
+}
+
+// output buffer为空时直接写socket，返回写出的字节数（出错时为0）
+// total是本次要发送的总字节数，全部写完才回调writeCompleteCallback_
+ssize_t TcpConnection::writeDirectly(const struct iovec* iov, int iovcnt,
+                                     size_t total, bool* faultError)
+{
+    assert(outputBuffer_.readableBytes() == 0);
+    ssize_t nwrote = iovcnt == 1
+        ? sockets::write(channel_.fd(), iov[0].iov_base, iov[0].iov_len)
+        : sockets::writev(channel_.fd(), iov, iovcnt);
+    if (nwrote >= 0) {
+        if (nwrote > 0) {
+            lastActive_ = loop_->pollReturnTime();// 只走直接写的连接也不能被当成空闲连接
+        }
+        if (implicit_cast<size_t>(nwrote) == total && writeCompleteCallback_) {// 写完了，回调writeCompleteCallback_
+            loop_->queueInLoop(boost::bind(writeCompleteCallback_, shared_from_this()));
+        }
+    }
+    else { // nwrote < 0
+        nwrote = 0;
+        if (errno != EWOULDBLOCK) {
+            LOG_SYSERR << "TcpConnection::writeDirectly";
+            if (errno == EPIPE || errno == ECONNRESET) {
+                *faultError = true;
+            }
+        }
+    }
+    return nwrote;
+}
+
+// 如果这次追加使待发送数据（output buffer加上文件段）越过highWaterMark_（高水位标），回调highWaterMarkCallback_
+void TcpConnection::checkHighWaterMark(size_t oldLen)
+{
+    size_t newLen = pendingOutputBytes();
+    if (newLen >= highWaterMark_
+        && oldLen < highWaterMark_
+        && highWaterMarkCallback_)
+    {
+        loop_->queueInLoop(boost::bind(highWaterMarkCallback_,
+                                       shared_from_this(),
+                                       newLen));
+    }
+    if (newLen >= highWaterMark_ && !throttling_) {
+        throttleReader(true);
+    }
+}
+
+// output减少之后调用
+void TcpConnection::checkLowWaterMark()
+{
+    if (throttling_ && pendingOutputBytes() <= lowWaterMark_) {
+        throttleReader(false);
+    }
+}
+
+void TcpConnection::throttleReader(bool on)
+{
+    TcpConnectionPtr reader(throttledReader_.lock());
+    if (reader) {
+        throttling_ = on;
+        // reader可能属于另一个IO线程
+        reader->getLoop()->runInLoop(
+            boost::bind(&TcpConnection::setReadThrottledInLoop, reader, on));
+    }
+    else {
+        throttling_ = false;
+    }
+}
+
+void TcpConnection::setReadBackpressure(const TcpConnectionPtr& reader, size_t lowWaterMark)
+{
+    loop_->assertInLoopThread();
+    assert(lowWaterMark < highWaterMark_);
+    if (throttling_) {
+        throttleReader(false);// 先放开原来的reader
+    }
+    throttledReader_ = reader;
+    lowWaterMark_ = lowWaterMark;
+    if (pendingOutputBytes() >= highWaterMark_) {
+        throttleReader(true);
+    }
+}
+
+void TcpConnection::stopRead()
+{
+    loop_->runInLoop(boost::bind(&TcpConnection::stopReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::startRead()
+{
+    loop_->runInLoop(boost::bind(&TcpConnection::startReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::stopReadInLoop()
+{
+    loop_->assertInLoopThread();
+    readStopped_ = true;
+    updateReading();
+}
+
+void TcpConnection::startReadInLoop()
+{
+    loop_->assertInLoopThread();
+    readStopped_ = false;
+    updateReading();
+}
+
+void TcpConnection::setReadThrottledInLoop(bool on)
+{
+    loop_->assertInLoopThread();
+    readThrottled_ = on;
+    updateReading();
+}
+
+// 用户和限流都允许时才读
+void TcpConnection::updateReading()
+{
+    if (state_ != kConnected && state_ != kDisconnecting) {
+        return;// 还没建立（connectEstablished时再决定），或者已经关闭
+    }
+    const bool want = !readStopped_ && !readThrottled_;
+    if (want && !channel_.isReading()) {
+        channel_.enableReading();
+    }
+    else if (!want && channel_.isReading()) {
+        channel_.disableReading();
+    }
 }
 
 void TcpConnection::shutdown()
@@ -182,16 +673,44 @@ void TcpConnection::shutdown()
 void TcpConnection::shutdownInLoop()
 {
     loop_->assertInLoopThread();
-    if (!channel_->isWriting())// 如果还有数据没发送完，那么只是将状态改为“kDisconnecting”，并没有关闭连接
+    if (!channel_.isWriting())// 如果还有数据没发送完，那么只是将状态改为“kDisconnecting”，并没有关闭连接
     {
         // we are not writing
-        socket_->shutdownWrite();// 关闭“写”
+        socket_.shutdownWrite();// 关闭“写”
+    }
+}
+
+void TcpConnection::forceClose()
+{
+    // FIXME: use compare and swap
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        // 总是放到队列中：调用者可能正在遍历连接（例如空闲连接检查），不能在这里就移除
+        loop_->queueInLoop(boost::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    loop_->assertInLoopThread();
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        // as if we received 0 byte in handleRead();
+        handleClose();
     }
 }
 
+void TcpConnection::setEdgeTriggered(bool on)
+{
+    assert(state_ == kConnecting);
+    // poller不支持时（poll、io_uring）保持电平触发
+    channel_.setEdgeTriggered(on && loop_->supportsEdgeTriggered());
+}
+
 void TcpConnection::setTcpNoDelay(bool on)
 {
-    socket_->setTcpNoDelay(on);
+    socket_.setTcpNoDelay(on);
 }
 
 void TcpConnection::connectEstablished()
@@ -199,9 +718,12 @@ void TcpConnection::connectEstablished()
     loop_->assertInLoopThread();
     assert(state_ == kConnecting);
     setState(kConnected);
+    lastActive_ = Timestamp::now();
     LOG_TRACE << "[3] usecount=" << shared_from_this().use_count();
-    channel_->tie(shared_from_this());// 跟TcpConnection的生存期有关
-    channel_->enableReading();// TcpConnection所对应的通道加入到Poller关注
+    channel_.tie(shared_from_this());// 跟TcpConnection的生存期有关
+    if (!readStopped_ && !readThrottled_) {
+        channel_.enableReading();
+    }// TcpConnection所对应的通道加入到Poller关注
 
     connectionCallback_(shared_from_this());// 用户的回调函数connectionCallback_
     LOG_TRACE << "[4] usecount=" << shared_from_this().use_count();
@@ -214,43 +736,69 @@ void TcpConnection::connectDestroyed()
     if (state_ == kConnected)
     {
         setState(kDisconnected);
-        channel_->disableAll();
+        channel_.disableAll();
 
         connectionCallback_(shared_from_this());
     }
-    channel_->remove();// 该通道从poll当中移除
+    channel_.remove();// 该通道从poll当中移除
+    loop_->connectionRemoved();
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
     loop_->assertInLoopThread();
-    int savedErrno = 0;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
-    if (n > 0) {
-        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
-        // shared_from_this将裸指针转换成shared_ptr
-    }
-    else if (n == 0) {
-        handleClose();
-    }
-    else {
-        errno = savedErrno;
-        LOG_SYSERR << "TcpConnection::handleRead";
-        handleError();
-    }
+    // 边沿触发时必须一直读到EAGAIN，否则剩下的数据不会再有通知
+    const bool drain = channel_.isEdgeTriggered();
+    do {
+        int savedErrno = 0;
+        ssize_t n = inputBuffer_.readFd(channel_.fd(), &savedErrno, loop_->readSpill());
+        if (n > 0) {
+            lastActive_ = receiveTime;
+            messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+            // shared_from_this将裸指针转换成shared_ptr
+        }
+        else if (n == 0) {
+            handleClose();
+            break;
+        }
+        else {
+            if (drain && (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)) {
+                break;  // 已经读空
+            }
+            errno = savedErrno;
+            LOG_SYSERR << "TcpConnection::handleRead";
+            handleError();
+            break;
+        }
+    } while (drain && state_ != kDisconnected && channel_.isReading());// 回调中可能stopRead()
 }
 
 void TcpConnection::handleWrite() // 内核发送缓冲区有空间了，回调该函数
 {
     loop_->assertInLoopThread();
-    if (channel_->isWriting()) {
-        ssize_t n  = sockets::write(channel_->fd(),
-                                    outputBuffer_.peak(),
-                                    outputBuffer_.read)
-        if (n > 0) {
-            outputBuffer_.retrieve(n);
-            if (outputBuffer_.readableBytes() == 0) {// 发送缓冲区已经清空
-                channel_->disableWriting();          // 停止关注可写事件，以免出现busy loop
+    if (channel_.isWriting()) {
+        // 边沿触发时一直写到发送完毕或者EAGAIN，LT模式下每次可写只写一次
+        const bool drain = channel_.isEdgeTriggered();
+        ssize_t n = 0;
+        int savedErrno = 0;
+        bool progressed = false;    // 边沿触发时最后一次可能是EAGAIN，看的是整个循环有没有写出数据
+        do {
+            // 一次writev把output buffer中的block（最多IOV_MAX个）写出去，轮到文件段时sendfile
+            n = writePending(&savedErrno);
+            if (n > 0) {
+                progressed = true;
+            }
+        } while (drain && n > 0 && pendingOutputBytes() > 0);
+
+        if (n < 0 && !(drain && (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK))) {
+            errno = savedErrno;
+            LOG_SYSERR << "TcpConnection::handleWrite";
+        }
+        if (progressed) {
+            lastActive_ = loop_->pollReturnTime();
+            checkLowWaterMark();
+            if (pendingOutputBytes() == 0) {// 发送缓冲区和文件段都已经清空
+                channel_.disableWriting();          // 停止关注可写事件，以免出现busy loop（边沿触发时只是清除标志）
                 if (writeCompleteCallback_) {        // 回调writeCompleteCallback_
                     // 应用层发送缓冲区被清空，就回调用writeCompleteCallback_
                     loop_->queueInLoop(boost::bind(writeCompleteCallback_, shared_from_this()));
@@ -265,16 +813,23 @@ void TcpConnection::handleWrite() // 内核发送缓冲区有空间了，回调
             }
         }
     }
+    else {
+        LOG_TRACE << "Connection fd = " << channel_.fd()
+                  << " is down, no more writing";
+    }
 }
 
 void TcpConnection::handleClose()
 {
     loop_->assertInLoopThread();
-    LOG_TRACE << "fd = " << channel_->fd() << " state = " << state_;
+    LOG_TRACE << "fd = " << channel_.fd() << " state = " << state_;
     assert(state_ == kConnected || state_ == kDisconnecting);
     // we don't close fd, leave it to dtor, so we can find leaks easily.
     setState(kDisconnected);
-    channel_->disableAll();
+    channel_.disableAll();
+    if (throttling_) {
+        throttleReader(false);// 不再有output了，别让reader一直停着
+    }
 
     TcpConnectionPtr guardThis(shared_from_this());
     connectionCallback_(guardThis);		// 这一行，可以不调用
@@ -286,7 +841,7 @@ void TcpConnection::handleClose()
 
 void TcpConnection::handleError()
 {
-    int err = sockets::getSocketError(channel_->fd());
-    LOG_ERROR << "TcpConnection::handleError [" << name_
+    int err = sockets::getSocketError(channel_.fd());
+    LOG_ERROR << "TcpConnection::handleError [" << name()
               << "] - SO_ERROR = " << err << " " << strerror_tl(err);
 }
@@ -7,18 +7,30 @@
 #ifndef MUDUO_NET_TCPCONNECTION_H
 #define MUDUO_NET_TCPCONNECTION_H
 
+#include <WebServer/base/Atomic.h>
 #include <WebServer/base/Mutex.h>
 #include <WebServer/base/StringPiece.h>
 #include <WebServer/base/Types.h>
 #include <WebServer/net/Callbacks.h>
 #include <WebServer/net/Buffer.h>
+#include <WebServer/net/ChainBuffer.h>
+#include <WebServer/net/Channel.h>
+#include <WebServer/net/ConnectionPool.h>
 #include <WebServer/net/InetAddress.h>
+#include <WebServer/net/Socket.h>
 
 #include <boost/any.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <deque>
+#include <vector>
+
+#include <sys/types.h>  // off_t
+
+struct iovec;
 
 namespace muduo
 {
@@ -35,23 +47,51 @@ namespace muduo
         class TcpConnection : boost::noncopyable,
                               public boost::enable_shared_from_this<TcpConnection>
         {
+        public:
+            typedef boost::shared_ptr<const string> NamePrefixPtr;
+
         private:
             enum StateE { kDisconnected, kConnecting, kConnected, kDisconnecting };
             void handleRead(Timestamp receiveTime);
+            void handleWrite();
             void handleClose();
             void handleError();
             void sendInLoop(const StringPiece& message);
             void sendInLoop(const void* message, size_t len);
+            void sendSlicesInLoop(const StringPiece* slices, size_t count);
+            void sendChunksInLoop(const std::vector<ChunkPtr>& chunks);
+            void sendChunkInLoop(const ChunkPtr& chunk);
+            void sendChunkArrayInLoop(const ChunkPtr* chunks, size_t count);
+            void sendBufferInLoop(const boost::shared_ptr<Buffer>& buf);
+            ssize_t writeDirectly(const struct iovec* iov, int iovcnt, size_t total, bool* faultError);
+            void sendFileInLoop(int fd, off_t offset, size_t len);
+            ssize_t writePending(int* savedErrno);
+            size_t pendingOutputBytes() const
+            { return outputBuffer_.readableBytes() + pendingFileBytes_; }
+            void checkHighWaterMark(size_t oldLen);
+            void checkLowWaterMark();
+            void throttleReader(bool on);
+            void startReadInLoop();
+            void stopReadInLoop();
+            void setReadThrottledInLoop(bool on);
+            void updateReading();
             void shutdownInLoop();
+            void forceCloseInLoop();
             void setState(StateE s) { state_ = s; }
 
+            void init(int sockfd);
+
             EventLoop* loop_;   // 所属的EventLoop
-            string     name_;   // 连接名
+            const string name_; // 连接名，由TcpServer创建时为空，按需用namePrefix_和id_拼接
+            const int64_t id_;  // 连接ID，由TcpServer创建时非0
+            const NamePrefixPtr namePrefix_;// 同一个TcpServer的连接共用
             StateE     state_;  // FIXME: use atomic variable
+            Timestamp  lastActive_;// 最近一次读到数据或者写出数据的时间，只在loop线程中修改
             
-            // we don't expose those classes to client.
-            boost::scoped_ptr<Socket>  socket_;
-            boost::scoped_ptr<Channel> channel_;
+            // 与TcpConnection在同一块内存中，不再单独分配
+            Socket  socket_;
+            Channel channel_;
+            const ConnectionPoolPtr pool_;// inputBuffer_的存储从这里取，析构时还回去
             InetAddress localAddr_;
             InetAddress peerAddr_;
             ConnectionCallback connectionCallback_;
@@ -64,8 +104,26 @@ namespace muduo
             HighWaterMarkCallback highWaterMarkCallback_;   // 高水位标回调函数
             CloseCallback closeCallback_;
             size_t highWaterMark_;      // 高水位标(outbuffer不断增大到一定程度)
+            size_t lowWaterMark_;       // 低水位标，限流之后output降到这里恢复读
+            boost::weak_ptr<TcpConnection> throttledReader_;// output超过高水位标时暂停读的连接（可以是自己）
+            bool throttling_;           // 是否正在让throttledReader_暂停读
+            bool readStopped_;          // 用户调用了stopRead()
+            bool readThrottled_;        // 被某个连接（或者自己）的output限流
             Buffer inputBuffer_;        // 应用层接收缓冲区
-            Buffer outputBuffer_;       // 应用层发送缓冲区
+            ChainBuffer outputBuffer_;  // 应用层发送缓冲区，block链，handleWrite时一次writev发出
+
+            // 等待sendfile的文件段，与outputBuffer_中的数据按send的顺序交错发送
+            struct FileSegment
+            {
+                int     fd;         // dup出来的文件描述符，发送完后关闭
+                off_t   offset;     // 下一次sendfile的起始位置
+                size_t  remaining;  // 还剩多少字节没有发送
+                int64_t streamPos;  // 在此之前outputBuffer_必须已经写出的字节数（累计值）
+            };
+            std::deque<FileSegment> pendingFiles_;
+            size_t  pendingFileBytes_;      // pendingFiles_中还未发送的字节数之和
+            int64_t outputBytesFlushed_;    // 累计从outputBuffer_写出的字节数
+            AtomicInt64 copyBytesAvoided_;  // 跨线程send时按引用交接、没有被拷贝的字节数，send可能在任意线程调用
             boost::any context_;        // 绑定一个未知类型的上下文对象
 
         public:
@@ -77,22 +135,75 @@ namespace muduo
                           int sockfd,
                           const InetAddress& localAddr,
                           const InetAddress& peerAddr);
+            /// Constructs a TcpConnection of a TcpServer, named *namePrefix + id,
+            /// the name is only built when asked for.
+            TcpConnection(EventLoop* loop,
+                          int64_t id,
+                          const NamePrefixPtr& namePrefix,
+                          int sockfd,
+                          const InetAddress& localAddr,
+                          const InetAddress& peerAddr);
             ~TcpConnection();
 
             EventLoop* getLoop() const { return loop_; }
-            const string& name() const { return name_; }
+            /// Built on each call for connections of a TcpServer, mostly for logging.
+            string name() const;
+            /// Unique within the TcpServer, 0 for connections of a TcpClient.
+            int64_t id() const { return id_; }
             const InetAddress& localAddress() { return localAddr_; }
             const InetAddress& peerAddress()  { return peerAddr_; }
             bool connected() const { return state_ == kConnected; }
 
-            // void send(string&& message); // C++11
+            /// Thread safe. From other threads the data is copied once into
+            /// a chunk, which is then queued by reference in the loop.
             void send(const void* message, size_t len);
             void send(const StringPiece& message);
-            // void send(Buffer&& message); // C++11
+            // C++11中字符串字面量转换到StringPiece和string&&一样好，有二义性
+            void send(const char* message);
+            /// Thread safe. From other threads the content of @c message is
+            /// swapped out, not copied, and @c message is left empty.
             void send(Buffer* message);// this one will swap data
+#if __cplusplus >= 201103L
+            /// Takes over @c message without copying it. From other threads it
+            /// is moved into a chunk, in the loop thread it is written directly.
+            void send(string&& message);
+            void send(Buffer&& message);
+#endif
+            /// Sends an immutable refcounted chunk, the bytes not written right
+            /// away are queued by reference, never copied.
+            /// The chunk must not be modified afterwards. Thread safe.
+            void send(const ChunkPtr& chunk);
+
+            /// Gather send, the slices are written with writev(2) in order,
+            /// without being joined into one buffer first.
+            /// Thread safe, but slices are copied once when called from other threads.
+            void send(const StringPiece* slices, size_t count);
+            /// Owned chunks are queued by reference, never copied.
+            /// Thread safe.
+            void send(const std::vector<ChunkPtr>& chunks);
+
+            /// Bytes that send() calls from other threads handed over to the loop
+            /// by swapping or by reference, where a copy used to be made.
+            /// Thread safe.
+            int64_t copyBytesAvoided() { return copyBytesAvoided_.get(); }
+
+            /// Sends @c len bytes of file @c fd from @c offset with sendfile(2),
+            /// in order with the data sent before and after it.
+            /// The fd is dup()ed, caller may close it right after this call.
+            /// Thread safe.
+            void sendFile(int fd, off_t offset, size_t len);
             void shutdown();// NOT thread safe, no simultaneous calling
+            /// Closes the connection without waiting for the output to be sent.
+            /// Thread safe.
+            void forceClose();
             void setTcpNoDelay(bool on);
 
+            /// Uses edge-triggered events if the poller supports it (epoll),
+            /// reads and writes are then repeated until EAGAIN, and
+            /// enabling/disabling writing costs no epoll_ctl.
+            /// Must be called before connectEstablished().
+            void setEdgeTriggered(bool on);
+
             void setContext(const boost::any& context)
             { context_ = context; }
 
@@ -113,10 +224,33 @@ namespace muduo
 
             void setHighWaterMarkCallback(const HighWaterMarkCallback& cb, size_t highWaterMark)
             { highWaterMarkCallback_ = cb; highWaterMark_ = highWaterMark; }
+            /// Loop thread only.
+            void setHighWaterMark(size_t highWaterMark)
+            { highWaterMark_ = highWaterMark; }
+
+            /// Stops/resumes reading from the socket, the kernel buffer then fills up
+            /// and TCP flow control slows the peer down. Thread safe.
+            void stopRead();
+            void startRead();
+            /// Whether the socket is being read, i.e. neither stopped nor throttled.
+            /// Loop thread only.
+            bool isReading() const { return channel_.isReading(); }
+
+            /// Automatic backpressure: pauses reading of @c reader while the output
+            /// of this connection is at or above the high water mark, resumes once it
+            /// drained to @c lowWaterMark. @c reader is this connection itself for
+            /// echo-like services, or the connection whose input is forwarded here for
+            /// proxies (it may belong to another loop). An empty @c reader disables it.
+            /// Loop thread only.
+            void setReadBackpressure(const TcpConnectionPtr& reader, size_t lowWaterMark);
 
             Buffer* inputBuffer()
             { return &inputBuffer_; }
 
+            /// Time of the last read or write on the socket (or of establishment).
+            /// Loop thread only.
+            Timestamp lastActiveTime() const { return lastActive_; }
+
             /// Internal use only.
             void setCloseCallback(const CloseCallback& cb)
             { closeCallback_ = cb; }
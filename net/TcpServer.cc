@@ -1,5 +1,6 @@
 #include <WebServer/net/TcpServer.h>
 
+#include <WebServer/base/CountDownLatch.h>
 #include <WebServer/base/Logging.h>
 #include <WebServer/net/Acceptor.h>
 #include <WebServer/net/EventLoop.h>
@@ -8,30 +9,53 @@
 #include <WebServer/net/SocketsOps.h>
 
 #include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+
+#include <algorithm>
 
 #include <stdio.h>
 
 using namespace muduo;
 using namespace muduo::net;
 
+TcpServer::LoopShard::LoopShard()
+    : loop(NULL),
+      idleCursor(0)
+{
+}
+
+TcpServer::LoopShard::~LoopShard()
+{
+}
+
 TcpServer::TcpServer(EventLoop* loop,
                      const InetAddress& listenAddr,
-                     const string& nameArg)
+                     const string& nameArg,
+                     Option option)
     : loop_(CHECK_NOTNULL(loop)),// 检查这个loop不是个空指针
       hostport_(listenAddr.toIpPort()),// 端口号
       name_(nameArg),
-      acceptor_(new Acceptor(loop, listenAddr)),// 用智能指针scoped_ptr<Acceptor>来管理
+      // kReusePort时要等start()才知道用不用loop_的acceptor，见start()
+      acceptor_(option == kReusePort ? NULL : new Acceptor(loop, listenAddr, false)),// 用智能指针scoped_ptr<Acceptor>来管理
       threadPool_(new EventLoopThreadPool(loop)),// 初始化,即是mainReactor，baseLoop_
       connectionCallback_(defaultConnectionCallback),// 声明在Callbacks.h
       messageCallback_(defaultMessageCallback),
       started_(false),// 是否启动
-      nextConnId_(1)
+      edgeTriggered_(false),
+      maxAcceptsPerWake_(Acceptor::kDefaultMaxAcceptsPerWake),
+      idleTickUs_(0),
+      connNamePrefix_(new string(nameArg + ":" + hostport_ + "#")),
+      listenAddr_(listenAddr),
+      reusePort_(option == kReusePort)
 {
-    // Poller::poll() -> Channel::handleEvent() -> Acceptor::handleRead()
-    // Acceptor::handleRead() -> TcpServer::newConnection()
-    // _1：socket文件描述符， _2：对等方的地址（InetAddress）
-    acceptor_->setNewConnectionCallback(
-        boost::bind(&TcpServer::newConnection, this, _1, _2));
+    nextConnId_.getAndSet(1);
+    if (acceptor_) {
+        // Poller::poll() -> Channel::handleEvent() -> Acceptor::handleRead()
+        // Acceptor::handleRead() -> TcpServer::newConnection()
+        // _1：socket文件描述符， _2：对等方的地址（InetAddress）
+        acceptor_->setNewConnectionCallback(
+            boost::bind(&TcpServer::newConnection, this, _1, _2));
+    }
 }
 
 TcpServer::~TcpServer()
@@ -39,13 +63,14 @@ TcpServer::~TcpServer()
     loop_->assertInLoopThread();
     LOG_TRACE << "TcpServer::~TcpServer [" << name_ << "] destructing";
 
-    for (ConnectionMap::iterator it(connections_.begin()); 
-         it != connections_.end(); ++it)
-    {
-        TcpConnectionPtr conn = it->second;
-        it->second.reset();		// 释放当前所控制的对象，引用计数减一
-        conn->getLoop()->runInLoop(boost::bind(&TcpConnection::connectDestroyed, conn));
-        conn.reset();			// 释放当前所控制的对象，引用计数减一
+    // 每个IO线程的连接（和acceptor）只能在它自己的线程中销毁，等待它们完成
+    // newConnection()转交连接的任务在此之前已经进入IO线程的队列，会先执行
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        CountDownLatch latch(1);
+        LoopShard* shard = &shards_[i];
+        shard->loop->runInLoop(
+            boost::bind(&TcpServer::stopShard, this, shard, &latch));
+        latch.wait();
     }
 }
 
@@ -58,104 +83,255 @@ void TcpServer::setThreadNum(int numThreads)
 
 // 该函数多次调用是无害的
 // 该函数可以跨线程调用
+void TcpServer::setDispatchPolicy(EventLoopThreadPool::DispatchPolicy policy)
+{
+    assert(!started_);
+    threadPool_->setDispatchPolicy(policy);
+}
+
+void TcpServer::setIdleTimeout(double seconds)
+{
+    assert(!started_);
+    assert(seconds >= 0);
+    idleTickUs_ = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond / kIdleBuckets);
+    if (seconds > 0 && idleTickUs_ < 1) {
+        idleTickUs_ = 1;// 不足kIdleBuckets微秒时截断成0，会悄悄关掉空闲检查
+    }
+}
+
+void TcpServer::setMaxAcceptsPerWake(int n)
+{
+    assert(!started_);
+    maxAcceptsPerWake_ = n;
+    if (acceptor_) {
+        acceptor_->setMaxAcceptsPerWake(n);
+    }
+}
+
+int64_t TcpServer::numAcceptWakeups()
+{
+    int64_t n = acceptor_ ? acceptor_->numWakeups() : 0;
+    // shards_在start()之后不再变化
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        if (shards_[i].acceptor) {
+            n += shards_[i].acceptor->numWakeups();
+        }
+    }
+    return n;
+}
+
+int64_t TcpServer::numAccepted()
+{
+    int64_t n = acceptor_ ? acceptor_->numAccepted() : 0;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        if (shards_[i].acceptor) {
+            n += shards_[i].acceptor->numAccepted();
+        }
+    }
+    return n;
+}
+
 void TcpServer::start()
 {
     if (!started_) {
         started_ = true;
         threadPool_->start(threadInitCallback_);
 
+        std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+        // kReusePort：每个IO线程一个acceptor，连接在哪个线程accept就属于哪个线程，
+        // 不再经过loop_转发
+        const bool loopAcceptors = reusePort_ && loops.front() != loop_;
+        if (reusePort_ && !loopAcceptors) {
+            // 没有IO线程，由loop_自己accept；所有监听socket都要在bind之前设置SO_REUSEPORT
+            acceptor_.reset(new Acceptor(loop_, listenAddr_, true));
+            acceptor_->setMaxAcceptsPerWake(maxAcceptsPerWake_);
+            acceptor_->setNewConnectionCallback(
+                boost::bind(&TcpServer::newConnection, this, _1, _2));
+        }
+        for (size_t i = 0; i < loops.size(); ++i) {
+            LoopShard* shard = new LoopShard;
+            shard->loop = loops[i];
+            shards_.push_back(shard);
+            if (idleTickUs_ > 0) {
+                shard->idleBuckets.resize(kIdleBuckets);
+                shard->idleTimer = loops[i]->runEvery(
+                    static_cast<double>(idleTickUs_) / Timestamp::kMicroSecondsPerSecond,
+                    boost::bind(&TcpServer::checkIdleInLoop, this, shard));
+            }
+            if (loopAcceptors) {
+                shard->acceptor.reset(new Acceptor(loops[i], listenAddr_, true));
+                shard->acceptor->setMaxAcceptsPerWake(maxAcceptsPerWake_);// 还没有listen，可以在这里设置
+                shard->acceptor->setNewConnectionCallback(
+                    boost::bind(&TcpServer::newConnectionInLoop, this, shard, _1, _2));
+                loops[i]->runInLoop(
+                    boost::bind(&Acceptor::listen, get_pointer(shard->acceptor)));
+            }
+        }
     }
 
-    if (!acceptor_->listenning()) {
+    if (!shards_.front().acceptor && !acceptor_->listenning()) {
 	    // get_pointer返回原生指针
         loop_->runInLoop(
             boost::bind(&Acceptor::listen, get_pointer(acceptor_)));
     }
 }
 
-void TcpServer::newConnection(int sockfd, const InerAddress& peerAddr)
+void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
 {
     loop_->assertInLoopThread();
-    // 按照轮询的方式选择一个EventLoop
-    EventLoop* ioLoop = threadPool_->getNextLoop();
-    char buf[32];
-    snprintf(buf, sizeof buf, ":%s#%d", hostport_.c_str(), nextConnId_);
-    ++nextConnId_;
-    string connName = name_ + buf;// 连接的名称
-
-    LOG_INFO << "TcpServer::newConnection [" << name_
-             << "] - new connection [" << connName;
-             << '] from ' << peerAddr.toIpPort();
-    InetAddress localAddr(sockets::getLocalAddr(sockfd));
-    // FIXME poll with zero timeout to double confirm the new connection
-    // FIXME use make_shared if necessary
-    TcpConnectionPtr conn(new TcpConnection(ioLoop, 
-                                            connName, 
-                                            sockfd,
-                                            localAddr, 
-                                            peerAddr));
+    // 按照分派策略选择一个EventLoop（默认轮询）
+    EventLoop* ioLoop = threadPool_->getNextLoop(peerAddr);
+    LoopShard* shard = shardOf(ioLoop);
+    TcpConnectionPtr conn(createConnection(shard, sockfd, peerAddr));
 
     LOG_TRACE << "[1] usecount=" << conn.use_count();
-    connections_[connName] = conn;
-    LOG_TRACE << "[2] usecount=" << conn.use_count();
-    conn->setConnectionCallback(connectionCallback_);
-    conn->setMessageCallback(messageCallback_);
-    conn->setWriteCompleteCallback(writeCompleteCallback_);
-
-    conn->setCloseCallback(
-        boost::bind(&TcpServer::removeConnection, this, _1));
-
     // conn->connectEstablished();// 在当前IO线程中调用（即loop_）
+    // 连接表属于IO线程，在那里登记
     ioLoop->runInLoop(
-        boost::bind(&TcpConnection::connectEstablished, conn));
+        boost::bind(&TcpServer::connectEstablishedInLoop, this, shard, conn));
 
     LOG_TRACE << "[5] usecount=" << conn.use_count();
 
 }
 
-void TcpServer::removeConnection(const TcpConnectionPtr& conn)
+// kReusePort：在accept的IO线程中直接建立连接，不需要跨线程
+void TcpServer::newConnectionInLoop(LoopShard* shard, int sockfd, const InetAddress& peerAddr)
 {
-	/*
-  loop_->assertInLoopThread();
-  LOG_INFO << "TcpServer::removeConnectionInLoop [" << name_
-           << "] - connection " << conn->name();
+    shard->loop->assertInLoopThread();
+    connectEstablishedInLoop(shard, createConnection(shard, sockfd, peerAddr));
+}
 
+void TcpServer::connectEstablishedInLoop(LoopShard* shard, const TcpConnectionPtr& conn)
+{
+    shard->loop->assertInLoopThread();
+    bool inserted = shard->connections.insert(conn->id(), conn);
+    (void)inserted;
+    assert(inserted);
+    LOG_TRACE << "[2] usecount=" << conn.use_count();
+    conn->connectEstablished();
+    if (!shard->idleBuckets.empty()) {
+        addIdleInLoop(shard, conn->id(), idleTickUs_ * kIdleBuckets);
+    }
+}
 
-  LOG_TRACE << "[8] usecount=" << conn.use_count();
-  size_t n = connections_.erase(conn->name());
-  LOG_TRACE << "[9] usecount=" << conn.use_count();
+// remainingUs微秒之后到期，放到那时会被检查的桶中
+void TcpServer::addIdleInLoop(LoopShard* shard, int64_t id, int64_t remainingUs)
+{
+    // 当前桶在下一个tick检查，往后第k个桶在k+1个tick之后检查
+    int64_t k = (remainingUs + idleTickUs_ - 1) / idleTickUs_ - 1;
+    k = std::max<int64_t>(0, std::min<int64_t>(k, kIdleBuckets - 1));
+    size_t idx = (shard->idleCursor + static_cast<size_t>(k)) % kIdleBuckets;
+    shard->idleBuckets[idx].push_back(id);
+}
 
-  (void)n;
-  assert(n == 1);
-  
-  loop_->queueInLoop(
-      boost::bind(&TcpConnection::connectDestroyed, conn));
-  LOG_TRACE << "[10] usecount=" << conn.use_count();
-  */
+void TcpServer::checkIdleInLoop(LoopShard* shard)
+{
+    shard->loop->assertInLoopThread();
+    const int64_t now = Timestamp::now().microSecondsSinceEpoch();
+    const int64_t timeoutUs = idleTickUs_ * kIdleBuckets;
+    const size_t cursor = shard->idleCursor;
+    std::vector<int64_t> ids;
+    ids.swap(shard->idleBuckets[cursor]);
+    shard->idleCursor = (cursor + 1) % kIdleBuckets;
 
-    loop_->runInLoop(
-        boost::bind(&TcpServer::removeConnectionInLoop, this, conn));
+    int closed = 0;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        TcpConnectionPtr conn(shard->connections.find(ids[i]));
+        if (!conn) {
+            continue;   // 已经关闭了
+        }
+        int64_t remaining = conn->lastActiveTime().microSecondsSinceEpoch() + timeoutUs - now;
+        if (remaining <= 0 && closed < kMaxIdleClosesPerTick) {
+            LOG_DEBUG << "TcpServer::checkIdleInLoop [" << name_
+                      << "] - closing idle connection " << conn->name();
+            conn->forceClose();// 在队列中关闭，不会影响这里的遍历
+            ++closed;
+        }
+        else {
+            addIdleInLoop(shard, ids[i], remaining);// 期间有过读写，或者本次关闭得太多
+        }
+    }
+    numIdleClosed_.add(closed);
 
+    // 保留桶的容量，下一轮不用再分配
+    if (shard->idleBuckets[cursor].empty()) {
+        ids.clear();
+        ids.swap(shard->idleBuckets[cursor]);
+    }
 }
 
-void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn)
+TcpConnectionPtr TcpServer::createConnection(LoopShard* shard, int sockfd, const InetAddress& peerAddr)
 {
-    loop_->assertInLoopThread();
-    LOG_INFO << "TcpServer::removeConnectionInLoop [" << name_
-             << "] - connection " << conn->name();
+    InetAddress localAddr(sockets::getLocalAddr(sockfd));
+    // FIXME poll with zero timeout to double confirm the new connection
+    // 连接的名称（name:ip:port#id）在用到时才拼接
+    // 对象和shared_ptr的控制块一次分配，内存来自IO线程的ConnectionPool，连接销毁后复用
+    TcpConnectionPtr conn(boost::allocate_shared<TcpConnection>(
+                              ConnectionAllocator<TcpConnection>(shard->loop->connectionPool()),
+                              shard->loop,
+                              nextConnId_.getAndAdd(1),
+                              connNamePrefix_, 
+                              sockfd,
+                              localAddr, 
+                              peerAddr));
+    // 每个连接都会打印，放在DEBUG级别：默认的INFO级别下不拼接连接的名称
+    LOG_DEBUG << "TcpServer::newConnection [" << name_
+              << "] - new connection [" << conn->name()
+              << "] from " << peerAddr.toIpPort();
+    conn->setConnectionCallback(connectionCallback_);
+    conn->setMessageCallback(messageCallback_);
+    conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setEdgeTriggered(edgeTriggered_);// 在connectEstablished之前设置
+    // 连接关闭时在IO线程中直接从连接表中移除，不需要经过loop_
+    conn->setCloseCallback(
+        boost::bind(&TcpServer::removeConnectionInLoop, this, shard, _1));
+    return conn;
+}
+
+TcpServer::LoopShard* TcpServer::shardOf(EventLoop* ioLoop)
+{
+    // IO线程不多，线性查找就够了
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        if (shards_[i].loop == ioLoop) {
+            return &shards_[i];
+        }
+    }
+    assert(!"unknown loop");
+    return NULL;
+}
+
+void TcpServer::removeConnectionInLoop(LoopShard* shard, const TcpConnectionPtr& conn)
+{
+    shard->loop->assertInLoopThread();
+    LOG_DEBUG << "TcpServer::removeConnectionInLoop [" << name_
+              << "] - connection " << conn->name();
 
 
     LOG_TRACE << "[8] usecount=" << conn.use_count();
-    size_t n = connections_.erase(conn->name());// 将对象conn从列表connections_中移除，引用计数-1
+    size_t n = shard->connections.erase(conn->id());// 将对象conn从连接表中移除，引用计数-1
     LOG_TRACE << "[9] usecount=" << conn.use_count();
 
     (void)n;
     assert(n == 1);
 
-    EventLoop* ioLoop = conn->getLoop();
-    loop_->queueInLoop(
+    shard->loop->queueInLoop(
         boost::bind(&TcpConnection::connectDestroyed, conn));
     // 此处得到一个boost::function对象并将conn传递进去，因此引用计数+1
     
     LOG_TRACE << "[10] usecount=" << conn.use_count();
 }
+
+void TcpServer::stopShard(LoopShard* shard, CountDownLatch* latch)
+{
+    shard->loop->assertInLoopThread();
+    if (!shard->idleBuckets.empty()) {
+        shard->loop->cancel(shard->idleTimer);
+    }
+    shard->acceptor.reset();     // 关闭监听socket
+    std::vector<TcpConnectionPtr> conns;
+    shard->connections.swapOut(&conns);
+    for (size_t i = 0; i < conns.size(); ++i) {
+        conns[i]->connectDestroyed();
+    }
+    latch->countDown();
+}
@@ -8,15 +8,21 @@ TcpConnection与Acceptor类似，有两个重要的数据成员，Socket与Chann
 #ifndef MUDUO_NET_TCPSERVER_H
 #define MUDUO_NET_TCPSERVER_H
 
+#include <WebServer/base/Atomic.h>
 #include <WebServer/base/Types.h>
+#include <WebServer/net/ConnectionTable.h>
+#include <WebServer/net/EventLoopThreadPool.h>
 #include <WebServer/net/TcpConnection.h>
+#include <WebServer/net/TimerId.h>
 
-#include <map>
 #include <boost/noncopyable.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
 #include <boost/scoped_ptr.hpp>
 
 namespace muduo
 {
+    class CountDownLatch;
+
     namespace net
     {
         class Acceptor;
@@ -29,35 +35,71 @@ namespace muduo
         class TcpServer : boost::noncopyable
         {
         private:
+            // 每个IO线程一个：该线程的连接表，以及kReusePort模式下自己的监听socket
+            // 只在loop线程中访问，不需要加锁
+            struct LoopShard : boost::noncopyable
+            {
+                EventLoop* loop;
+                boost::scoped_ptr<Acceptor> acceptor;   // 只在kReusePort模式下有
+                ConnectionTable connections;            // <连接ID, 连接对象的指针>
+                // 空闲超时：按到期时间分桶的连接ID，每个tick检查一个桶
+                // 读写时连接只更新lastActiveTime()，检查到还没到期的再放回对应的桶
+                std::vector<std::vector<int64_t> > idleBuckets;
+                size_t idleCursor;                      // 下一个检查的桶
+                TimerId idleTimer;
+
+                LoopShard();
+                ~LoopShard();   // Acceptor在这里是不完整类型
+            };
+
             // Not thread safe, but in loop
             void newConnection(int sockfd, const InetAddress& peerAddr);// 连接到来
-            /// Thread safe.
-            void removeConnection(const TcpConnectionPtr& conn);
-
-            typedef std::map<string, TcpConnectionPtr> ConnectionMap;// 连接列表<连接的名称,连接对象的指针>
+            // In the loop of @c shard
+            void newConnectionInLoop(LoopShard* shard, int sockfd, const InetAddress& peerAddr);
+            void connectEstablishedInLoop(LoopShard* shard, const TcpConnectionPtr& conn);
+            void removeConnectionInLoop(LoopShard* shard, const TcpConnectionPtr& conn);
+            void stopShard(LoopShard* shard, CountDownLatch* latch);
+            void addIdleInLoop(LoopShard* shard, int64_t id, int64_t remainingUs);
+            void checkIdleInLoop(LoopShard* shard);
+            // 创建连接对象，设置好用户回调，两种accept方式共用
+            TcpConnectionPtr createConnection(LoopShard* shard, int sockfd, const InetAddress& peerAddr);
+            LoopShard* shardOf(EventLoop* ioLoop);
 
             EventLoop*   loop_;         // acceptor_所属的EventLoop
             const string hostport_;     // 服务端口
             const string name_;         // 服务名
             // avoid revealing Acceptor
-            boost::scoped_ptr<Acceptor> acceptor_;  // 有了Acceptor类对象就有了socket,listen,bind的功能，避免暴露Acceptor
+            boost::scoped_ptr<Acceptor> acceptor_;  // 有了Acceptor类对象就有了socket,listen,bind的功能，避免暴露Acceptor；kReusePort模式下有IO线程时为空
             boost::scoped_ptr<EventLoopThreadPool> threadPool_;
             ConnectionCallback connectionCallback_; // “连接到来”的回调函数
             MessageCallback messageCallback_;       // “消息到来”的回调函数
             WriteCompleteCallback writeCompleteCallback_;// 数据发送完毕，会回调此函数
             ThreadInitCallback threadInitCallback_;      // IO线程池中的线程在进入事件循环前，会回调用此函数
             bool started_;      // 是否已经启动了
-            // always in loop thread
-            int nextConnId_;    // 下一个连接ID
-            ConnectionMap connections_;// 连接列表
+            bool edgeTriggered_;// 新连接是否使用边沿触发
+            int maxAcceptsPerWake_;// 每个acceptor每次可读事件最多accept的连接数
+            int64_t idleTickUs_;// 空闲检查的间隔（微秒），0表示不检查
+            AtomicInt64 numIdleClosed_;// 因为空闲超时而关闭的连接数
+            AtomicInt64 nextConnId_;    // 下一个连接ID，kReusePort模式下多个IO线程同时使用
+            const TcpConnection::NamePrefixPtr connNamePrefix_;// 连接名的公共部分"name:ip:port#"，连接名按需拼接
+            const InetAddress listenAddr_;
+            const bool reusePort_;
+            boost::ptr_vector<LoopShard> shards_;// 每个IO线程一个，start()之后不再变化
 
         public:
             //typedef boost::function<void(EventLoop*)> ThreadInitCallback;
 
+            enum Option
+            {
+                kNoReusePort,   // 在loop中accept，再按轮询分给IO线程
+                kReusePort,     // 每个IO线程用SO_REUSEPORT监听同一个地址，自己accept
+            };
+
             //TcpServer(EventLoop* loop, const InetAddress& listenAddr);
             TcpServer(EventLoop* loop,
                       const InetAddress& listenAddr,
-                      const string& nameArg);
+                      const string& nameArg,
+                      Option option = kNoReusePort);
             ~TcpServer();  // force out-line dtor, for scoped_ptr members.
 
             const string& hostport() const { return hostport_; }
@@ -72,10 +114,50 @@ namespace muduo
             ///   this is the default value.
             /// - 1 means all I/O in another thread.
             /// - N means a thread pool with N threads, new connections are assigned on a round-robin basis.
+            ///   With kReusePort, each of the N threads accepts its own connections
+            ///   and the kernel spreads them, loop's thread accepts nothing.
             void setThreadNum(int numThreads);
             void setThreadInitCallback(const ThreadInitCallback& cb)
             { threadInitCallback_ = cb; }
 
+            /// How new connections are assigned to the N threads,
+            /// see EventLoopThreadPool::DispatchPolicy. Default is round-robin.
+            /// Not used with kReusePort, where the kernel picks the thread.
+            /// Must be called before @c start
+            void setDispatchPolicy(EventLoopThreadPool::DispatchPolicy policy);
+
+            /// The IO thread pool, e.g. for EventLoopThreadPool::setPlacement()
+            /// before @c start, or to inspect the loops after.
+            EventLoopThreadPool* threadPool() { return get_pointer(threadPool_); }
+
+            /// Use edge-triggered events for new connections when the poller
+            /// supports it (epoll), see TcpConnection::setEdgeTriggered().
+            /// Must be called before @c start
+            void setEdgeTriggered(bool on)
+            { edgeTriggered_ = on; }
+
+            /// Accept up to @c n connections per readiness event of the listening
+            /// socket(s), see Acceptor::setMaxAcceptsPerWake().
+            /// Must be called before @c start
+            void setMaxAcceptsPerWake(int n);
+
+            /// Force-closes connections with no read or write for @c seconds,
+            /// checked in batches by a bucketed wheel in each IO loop, a connection
+            /// is closed between @c seconds and (1 + 1/kIdleBuckets) * @c seconds
+            /// after its last activity. 0 (default) disables it.
+            /// Must be called before @c start
+            void setIdleTimeout(double seconds);
+            /// Number of connections closed for being idle. Thread safe.
+            int64_t numIdleClosed() { return numIdleClosed_.get(); }
+
+            static const int kIdleBuckets = 16;
+            static const int kMaxIdleClosesPerTick = 1024;// 每次检查最多关闭的连接数，剩下的推迟到下一个tick
+
+            /// Accept statistics summed over all acceptors.
+            /// Thread safe.
+            int64_t numAcceptWakeups();
+            int64_t numAccepted();
+
             /// Starts the server if it's not listenning.
             ///
             /// It's harmless to call it multiple times.
@@ -94,6 +176,12 @@ namespace muduo
             void setMessageCallback(const MessageCallback& cb)
             { messageCallback_ = cb; }
 
+            /// Set write complete callback.
+            /// Not thread safe.
+            // 设置“数据发送完毕”回调函数
+            void setWriteCompleteCallback(const WriteCompleteCallback& cb)
+            { writeCompleteCallback_ = cb; }
+
         }; // class TcpServer
             
     } // namespace net
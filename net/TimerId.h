@@ -19,6 +19,7 @@ namespace muduo
             int64_t  sequence_;     // 定时器序号
         public:
             friend class TimerQueue;
+            friend class TimerWheel;
 
             TimerId()
                 : timer_(NULL),
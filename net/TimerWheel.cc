@@ -0,0 +1,383 @@
+#include <WebServer/net/TimerWheel.h>
+
+#include <WebServer/base/Logging.h>
+#include <WebServer/net/EventLoop.h>
+#include <WebServer/net/TimerId.h>
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <new>
+
+#include <assert.h>
+#include <strings.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+    int createTimerfd()
+    {
+        int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (timerfd < 0) {
+            LOG_SYSFATAL << "Failed in timerfd_create";
+        }
+        return timerfd;
+    }
+
+    void readTimerfd(int timerfd, Timestamp now)
+    {
+        uint64_t howmany;
+        ssize_t n = ::read(timerfd, &howmany, sizeof howmany);
+        LOG_TRACE << "TimerWheel::handleRead() " << howmany << " at " << now.toString();
+        if (n != sizeof howmany) {
+            LOG_ERROR << "TimerWheel::handleRead() reads " << n << " bytes instead of 8";
+        }
+    }
+
+    // 只在下一个非空槽的时刻唤醒一次
+    void resetTimerfd(int timerfd, Timestamp expiration)
+    {
+        int64_t microseconds = expiration.microSecondsSinceEpoch()
+                             - Timestamp::now().microSecondsSinceEpoch();
+        if (microseconds < 100) {
+            microseconds = 100;
+        }
+        struct itimerspec newValue;
+        bzero(&newValue, sizeof newValue);
+        newValue.it_value.tv_sec = static_cast<time_t>(microseconds / Timestamp::kMicroSecondsPerSecond);
+        newValue.it_value.tv_nsec = static_cast<long>((microseconds % Timestamp::kMicroSecondsPerSecond) * 1000);
+        if (::timerfd_settime(timerfd, 0, &newValue, NULL)) {
+            LOG_SYSERR << "timerfd_settime()";
+        }
+    }
+
+    // level层每个槽覆盖2^shift个tick
+    int levelShift(int level)
+    {
+        return level == 0 ? 0 : 8 + 6 * (level - 1);
+    }
+
+    void setBit(uint64_t* bitmap, int i)   { bitmap[i >> 6] |= uint64_t(1) << (i & 63); }
+    void clearBit(uint64_t* bitmap, int i) { bitmap[i >> 6] &= ~(uint64_t(1) << (i & 63)); }
+    bool testBit(const uint64_t* bitmap, int i) { return bitmap[i >> 6] & (uint64_t(1) << (i & 63)); }
+
+    // [from, end)中第一个置位的下标，没有则返回end
+    int findFirstSet(const uint64_t* bitmap, int from, int end)
+    {
+        for (int i = from; i < end; ) {
+            uint64_t word = bitmap[i >> 6] >> (i & 63);
+            if (word) {
+                int found = i + __builtin_ctzll(word);
+                return found < end ? found : end;
+            }
+            i = (i | 63) + 1;   // 下一个word
+        }
+        return end;
+    }
+}
+
+TimerWheel::TimerWheel(EventLoop* loop, double tick)
+    : loop_(loop),
+      tickUs_(tick * Timestamp::kMicroSecondsPerSecond >= 1
+              ? static_cast<int64_t>(tick * Timestamp::kMicroSecondsPerSecond) : 1),
+      start_(Timestamp::now()),
+      timerfd_(createTimerfd()),
+      timerfdChannel_(loop, timerfd_),
+      currentTick_(0),
+      armedTick_(-1),
+      numTimers_(0),
+      callingExpiredTimers_(false),
+      freeList_(NULL)
+{
+    for (int i = 0; i < kLevels; ++i) {
+        int numSlots = i == 0 ? kLevel0Slots : kLevelSlots;
+        levels_[i].slots.resize(numSlots);
+        levels_[i].bitmap.resize((numSlots + 63) / 64);
+        for (int j = 0; j < numSlots; ++j) {
+            ListHook& head = levels_[i].slots[j];
+            head.prev = head.next = &head;  // 空链表
+        }
+    }
+    timerfdChannel_.setReadCallback(boost::bind(&TimerWheel::handleRead, this));
+    timerfdChannel_.enableReading();
+}
+
+TimerWheel::~TimerWheel()
+{
+    ::close(timerfd_);
+    // Do not remove channel, since we're in EventLoop::dtor()
+    for (int i = 0; i < kLevels; ++i) {
+        for (size_t j = 0; j < levels_[i].slots.size(); ++j) {
+            ListHook* head = &levels_[i].slots[j];
+            for (ListHook* h = head->next; h != head; h = h->next) {
+                static_cast<Node*>(h)->timer()->~Timer();
+            }
+        }
+    }
+    for (size_t i = 0; i < chunks_.size(); ++i) {
+        delete[] chunks_[i];
+    }
+}
+
+TimerWheel::Node* TimerWheel::allocNode()
+{
+    MutexLockGuard lock(mutex_);
+    if (freeList_ == NULL) {
+        Node* chunk = new Node[kNodesPerChunk];
+        chunks_.push_back(chunk);
+        for (int i = 0; i < kNodesPerChunk; ++i) {
+            chunk[i].sequence = 0;
+            chunk[i].state = kFree;
+            chunk[i].next = i + 1 < kNodesPerChunk ? &chunk[i + 1] : NULL;
+        }
+        freeList_ = chunk;
+    }
+    Node* node = freeList_;
+    freeList_ = static_cast<Node*>(node->next);
+    return node;
+}
+
+// 只在loop线程中调用
+void TimerWheel::freeNode(Node* node)
+{
+    node->timer()->~Timer();
+    node->sequence = 0;     // 之后持有旧TimerId的cancel都会被忽略
+    node->state = kFree;
+    MutexLockGuard lock(mutex_);
+    node->next = freeList_;
+    freeList_ = node;
+}
+
+TimerId TimerWheel::addTimer(const TimerCallback& cb,
+                             Timestamp when,
+                             double interval)
+{
+    Node* node = allocNode();
+    Timer* timer = new (&node->storage) Timer(cb, when, interval);
+    int64_t sequence = timer->sequence();
+    loop_->runInLoop(boost::bind(&TimerWheel::addTimerInLoop, this, node));
+    // TimerId对用户是不透明的，这里保存的其实是Node的地址
+    return TimerId(reinterpret_cast<Timer*>(node), sequence);
+}
+
+void TimerWheel::cancel(TimerId timerId)
+{
+    loop_->runInLoop(boost::bind(&TimerWheel::cancelInLoop, this, timerId));
+}
+
+void TimerWheel::addTimerInLoop(Node* node)
+{
+    loop_->assertInLoopThread();
+    node->sequence = node->timer()->sequence();
+    node->state = kInWheel;
+    insert(node);
+    ++numTimers_;
+    // handleRead()结束时会统一重置timerfd
+    if (!callingExpiredTimers_ && (armedTick_ < 0 || node->expireTick < armedTick_)) {
+        armedTick_ = node->expireTick;
+        resetTimerfd(timerfd_, timeOf(armedTick_));
+    }
+}
+
+void TimerWheel::cancelInLoop(TimerId timerId)
+{
+    loop_->assertInLoopThread();
+    Node* node = reinterpret_cast<Node*>(timerId.timer_);
+    if (node == NULL || node->sequence != timerId.sequence_) {
+        return;     // 已经到期或者已经取消
+    }
+    if (node->state == kInWheel) {
+        unlink(node);
+        --numTimers_;
+        freeNode(node);
+    }
+    else if (node->state == kExpired) {
+        // 已经到期，正在调用回调函数的定时器，不会再运行或重启
+        node->state = kCanceled;
+    }
+}
+
+void TimerWheel::handleRead()
+{
+    loop_->assertInLoopThread();
+    Timestamp now(Timestamp::now());
+    readTimerfd(timerfd_, now);
+    armedTick_ = -1;
+
+    // 推进到当前时刻所在的tick，跳过level0中的空槽，但不会跳过cascade的时刻
+    const int64_t target = (now.microSecondsSinceEpoch() - start_.microSecondsSinceEpoch()) / tickUs_;
+    const uint64_t* bitmap0 = &*levels_[0].bitmap.begin();
+    while (currentTick_ <= target) {
+        int index = static_cast<int>(currentTick_ & (kLevel0Slots - 1));
+        if (index == 0) {
+            for (int level = 1; level < kLevels; ++level) {
+                cascade(level);
+                if (((currentTick_ >> levelShift(level)) & (kLevelSlots - 1)) != 0) {
+                    break;
+                }
+            }
+        }
+        if (testBit(bitmap0, index)) {
+            collectExpired(currentTick_);
+        }
+        int next = findFirstSet(bitmap0, index + 1, kLevel0Slots);
+        currentTick_ = std::min(currentTick_ + (next - index), target + 1);
+    }
+
+    callingExpiredTimers_ = true;
+    for (size_t i = 0; i < expired_.size(); ++i) {
+        if (expired_[i]->state == kExpired) {   // 同一批中可能被前面的回调取消
+            expired_[i]->timer()->run();
+        }
+    }
+    callingExpiredTimers_ = false;
+
+    for (size_t i = 0; i < expired_.size(); ++i) {
+        Node* node = expired_[i];
+        if (node->timer()->repeat() && node->state == kExpired) {
+            node->timer()->restart(now);
+            node->state = kInWheel;
+            insert(node);
+            ++numTimers_;
+        }
+        else {
+            freeNode(node);
+        }
+    }
+    expired_.clear();
+    rearm();
+}
+
+void TimerWheel::insert(Node* node)
+{
+    int64_t tick = tickOf(node->timer()->expiration());
+    if (tick < currentTick_) {
+        tick = currentTick_;
+    }
+    node->expireTick = tick;
+
+    const int64_t kMaxDelta = (int64_t(1) << levelShift(kLevels)) - 1;
+    int64_t delta = tick - currentTick_;
+    if (delta > kMaxDelta) {
+        tick = currentTick_ + kMaxDelta;    // 超出范围的先放在最高层，cascade时重新计算
+        delta = kMaxDelta;
+    }
+    int level = 0;
+    while (level + 1 < kLevels && delta >= (int64_t(1) << levelShift(level + 1))) {
+        ++level;
+    }
+    const int mask = level == 0 ? kLevel0Slots - 1 : kLevelSlots - 1;
+    const int slot = static_cast<int>((tick >> levelShift(level)) & mask);
+    node->level = level;
+    node->slot = slot;
+
+    // 挂到槽的链表尾部
+    ListHook* head = &levels_[level].slots[slot];
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+    setBit(&*levels_[level].bitmap.begin(), slot);
+}
+
+void TimerWheel::unlink(Node* node)
+{
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    ListHook* head = &levels_[node->level].slots[node->slot];
+    if (head->next == head) {
+        clearBit(&*levels_[node->level].bitmap.begin(), node->slot);
+    }
+}
+
+void TimerWheel::cascade(int level)
+{
+    const int slot = static_cast<int>((currentTick_ >> levelShift(level)) & (kLevelSlots - 1));
+    ListHook* head = &levels_[level].slots[slot];
+    if (head->next == head) {
+        return;
+    }
+    // 先整条摘下来，再逐个按照当前tick重新放入
+    ListHook* first = head->next;
+    head->prev->next = NULL;
+    head->prev = head->next = head;
+    clearBit(&*levels_[level].bitmap.begin(), slot);
+    while (first != NULL) {
+        Node* node = static_cast<Node*>(first);
+        first = first->next;
+        insert(node);
+    }
+}
+
+void TimerWheel::collectExpired(int64_t tick)
+{
+    const int slot = static_cast<int>(tick & (kLevel0Slots - 1));
+    ListHook* head = &levels_[0].slots[slot];
+    for (ListHook* h = head->next; h != head; h = h->next) {
+        Node* node = static_cast<Node*>(h);
+        assert(node->expireTick == tick);
+        node->state = kExpired;
+        expired_.push_back(node);
+        --numTimers_;
+    }
+    head->prev = head->next = head;
+    clearBit(&*levels_[0].bitmap.begin(), slot);
+}
+
+int64_t TimerWheel::nextEventTick() const
+{
+    int64_t next = -1;
+    // level0中的定时器都在[currentTick_, currentTick_ + 256)之内，按环形查找
+    const uint64_t* bitmap0 = &*levels_[0].bitmap.begin();
+    const int c0 = static_cast<int>(currentTick_ & (kLevel0Slots - 1));
+    int index = findFirstSet(bitmap0, c0, kLevel0Slots);
+    if (index < kLevel0Slots) {
+        next = currentTick_ + (index - c0);
+    }
+    else if ((index = findFirstSet(bitmap0, 0, c0)) < c0) {
+        next = currentTick_ + (kLevel0Slots - c0 + index);
+    }
+
+    // 高层非空槽要在它被cascade的时刻唤醒
+    for (int level = 1; level < kLevels; ++level) {
+        uint64_t bits = levels_[level].bitmap[0];
+        if (bits == 0) {
+            continue;
+        }
+        const int shift = levelShift(level);
+        const int c = static_cast<int>((currentTick_ >> shift) & (kLevelSlots - 1));
+        // 从c+1开始环形查找，当前槽c要等转完一整圈（distance为64）
+        const int s = (c + 1) & (kLevelSlots - 1);
+        uint64_t rotated = s ? (bits >> s) | (bits << (64 - s)) : bits;
+        int64_t distance = 1 + __builtin_ctzll(rotated);
+        int64_t tick = ((currentTick_ >> shift) + distance) << shift;
+        if (next < 0 || tick < next) {
+            next = tick;
+        }
+    }
+    return next;
+}
+
+void TimerWheel::rearm()
+{
+    int64_t next = nextEventTick();
+    if (next >= 0) {
+        armedTick_ = next;
+        resetTimerfd(timerfd_, timeOf(next));
+    }
+}
+
+int64_t TimerWheel::tickOf(Timestamp when) const
+{
+    int64_t us = when.microSecondsSinceEpoch() - start_.microSecondsSinceEpoch();
+    return us <= 0 ? 0 : (us + tickUs_ - 1) / tickUs_;    // 向上取整，不会提前到期
+}
+
+Timestamp TimerWheel::timeOf(int64_t tick) const
+{
+    return Timestamp(start_.microSecondsSinceEpoch() + tick * tickUs_);
+}
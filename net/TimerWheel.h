@@ -0,0 +1,141 @@
+/*
+TimerWheel：分层的哈希时间轮，TimerQueue的另一种实现，接口与TimerQueue相同（addTimer/cancel）
+
+TimerQueue用两个std::set保存定时器，添加、取消都是两次红黑树操作，每个Timer都要new一次。
+连接很多、每个连接都有空闲/请求超时定时器时，这部分开销很明显。
+
+TimerWheel把时间按tick（默认1ms）离散化：
+    level0  256个槽，每槽1个tick，覆盖256个tick
+    level1~4 各64个槽，每槽覆盖低一层的整圈，总共覆盖2^32个tick
+- 每个槽是一个侵入式双向链表，添加、取消都是O(1)，不需要查找
+- 节点（内含Timer对象）来自空闲链表，用完归还，不调用malloc/free
+- level0转完一圈时，把上一层当前槽中的定时器重新分配到下一层（cascade）
+- 用位图记录哪些槽非空，timerfd只设置到下一个非空槽的时刻，而不是每个tick都唤醒
+*/
+
+#ifndef MUDUO_NET_TIMERWHEEL_H
+#define MUDUO_NET_TIMERWHEEL_H
+
+#include <boost/noncopyable.hpp>
+#include <boost/type_traits/aligned_storage.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+
+#include <WebServer/base/Mutex.h>
+#include <WebServer/base/Timestamp.h>
+#include <WebServer/net/Callbacks.h>
+#include <WebServer/net/Channel.h>
+#include <WebServer/net/Timer.h>
+
+#include <vector>
+
+#include <stdint.h>
+
+namespace muduo
+{
+    namespace net
+    {
+        class EventLoop;
+        class TimerId;
+
+        ///
+        /// Hashed hierarchical timing wheel, a drop-in alternative to TimerQueue.
+        ///
+        /// Timers fire no earlier than requested, and at most one tick later.
+        class TimerWheel : boost::noncopyable
+        {
+        private:
+            static const int kLevels = 5;
+            static const int kLevel0Bits = 8;
+            static const int kLevelBits = 6;
+            static const int kLevel0Slots = 1 << kLevel0Bits;  // 256
+            static const int kLevelSlots = 1 << kLevelBits;     // 64
+            static const int kNodesPerChunk = 256;              // 每次向系统申请的节点个数
+
+            struct ListHook
+            {
+                ListHook* prev;
+                ListHook* next;
+            };
+
+            enum NodeState { kFree, kPending, kInWheel, kExpired, kCanceled };
+
+            // 一个定时器节点，Timer对象用placement new构造在storage中
+            struct Node : ListHook
+            {
+                boost::aligned_storage<sizeof(Timer), boost::alignment_of<Timer>::value>::type storage;
+                int64_t   sequence;     // 在轮中的定时器的序号，只在loop线程中读写，用于cancel时的校验
+                int64_t   expireTick;
+                int       level;
+                int       slot;
+                NodeState state;
+
+                Timer* timer() { return static_cast<Timer*>(static_cast<void*>(&storage)); }
+            };
+
+            struct Level
+            {
+                std::vector<ListHook> slots;    // 每个槽是一个带哨兵的循环链表
+                std::vector<uint64_t> bitmap;   // 非空槽的位图
+            };
+
+            // 节点池，可能在其它线程中调用addTimer，所以要加锁
+            Node* allocNode();
+            void  freeNode(Node* node);
+
+            void addTimerInLoop(Node* node);
+            void cancelInLoop(TimerId timerId);
+
+            void handleRead();
+
+            void insert(Node* node);            // 按照expireTick放入对应的层和槽
+            void unlink(Node* node);            // 从所在的槽中摘下
+            void cascade(int level);            // 把level层当前槽中的节点重新分配到低层
+            void collectExpired(int64_t tick);  // 把level0中tick所在槽的节点移到expired_
+            int64_t nextEventTick() const;      // 下一个非空槽的tick，没有返回-1
+            void rearm();                       // 按照nextEventTick()重置timerfd
+
+            int64_t tickOf(Timestamp when) const;       // 不早于when的第一个tick
+            Timestamp timeOf(int64_t tick) const;
+
+            EventLoop* loop_;           // 所属EventLoop
+            const int64_t tickUs_;      // 一个tick的微秒数
+            const Timestamp start_;     // tick 0所对应的时刻
+            const int timerfd_;
+            Channel timerfdChannel_;
+
+            Level   levels_[kLevels];
+            int64_t currentTick_;       // 小于currentTick_的tick都已经处理过
+            int64_t armedTick_;         // timerfd当前设置到的tick，-1表示没有设置
+            size_t  numTimers_;         // 轮中的定时器个数
+
+            std::vector<Node*> expired_;    // 本次到期的节点
+            bool callingExpiredTimers_;     // 是否处于调用“处理超时定时器”的过程中
+
+            MutexLock mutex_;
+            Node* freeList_;                    // 空闲节点，用next串起来
+            std::vector<Node*> chunks_;         // 所有申请的节点块，析构时释放
+
+        public:
+            /// @param tick resolution in seconds, 1ms by default.
+            explicit TimerWheel(EventLoop* loop, double tick = 0.001);
+            ~TimerWheel();
+
+            /// Schedules the callback to be run at given time,
+            /// repeats if @c interval > 0.0.
+            ///
+            /// Thread safe.
+            TimerId addTimer(const TimerCallback& cb,
+                             Timestamp when,
+                             double interval);
+
+            /// O(1), thread safe.
+            void cancel(TimerId timerId);
+
+            size_t size() const { return numTimers_; }
+
+        }; // class TimerWheel
+
+    } // namespace net
+} // namespace muduo
+
+#endif  // MUDUO_NET_TIMERWHEEL_H
@@ -10,16 +10,16 @@ HttpServer：http服务器类封装
 
 #include <WebServer/base/copyable.h>
 #include <WebServer/net/http/HttpRequest.h>
+#include <WebServer/net/http/HttpResponse.h>
+
+#include <assert.h>
+
 namespace muduo
 {
     namespace net
     {
         class HttpContext : public WebServer::copyable
         {
-        private:
-            HttpRequestParseState   state_;     // 请求解析状态
-            HttpRequest             request_;   // http请求
-
         public:
             enum HttpRequestParseState
             {
@@ -29,8 +29,52 @@ namespace muduo
                 kGotAll,                // 全部解析完毕
             };
 
+            // 接收body的状态
+            enum BodyState
+            {
+                kContentLength,         // 还有bodyRemaining_个字节
+                kChunkSize,             // chunk的长度行
+                kChunkData,             // chunk的数据，还有bodyRemaining_个字节
+                kChunkDataEnd,          // chunk数据之后的CRLF
+                kChunkTrailer,          // 最后一个chunk之后的trailer，直到空行
+            };
+
+        private:
+            HttpRequestParseState   state_;     // 请求解析状态
+            HttpRequest             request_;   // http请求，引用input buffer中的数据
+            // 已经解析、还留在buffer中的字节数（从buffer的peek()算起）
+            // 请求行、header和Content-Length的body在请求处理之前都不retrieve
+            size_t                  parsed_;
+            // 已经查找过CRLF的字节数（从buffer的peek()算起），数据分多次到达时
+            // 从这里继续找，不重新扫描不完整的行
+            size_t                  scanned_;
+            BodyState               bodyState_;
+            size_t                  bodyRemaining_;
+            bool                    streamBody_;    // body交给body回调，不留在请求中
+            bool                    sendContinue_;  // 请求带有"Expect: 100-continue"，还没有回复
+            bool                    bodyTooLarge_;
+            // 正在发送的流式响应，发送完之前后面（流水线）的请求不处理
+            // 不属于某个请求，reset()不清除
+            HttpResponse::BodyStream responseStream_;
+            bool                    responseChunked_;
+            bool                    closeAfterResponse_;
+            bool                    waitingResponse_;   // 有一个延迟完成的响应还没有done()
+
+        public:
+            static const size_t kMaxHeaderBytes = 64 * 1024;// 请求行和header的总长度上限
+
             HttpContext()
-                : state_(kExpectRequestLine) // 初始状态：希望收到的是请求行
+                : state_(kExpectRequestLine), // 初始状态：希望收到的是请求行
+                  parsed_(0),
+                  scanned_(0),
+                  bodyState_(kContentLength),
+                  bodyRemaining_(0),
+                  streamBody_(false),
+                  sendContinue_(false),
+                  bodyTooLarge_(false),
+                  responseChunked_(false),
+                  closeAfterResponse_(false),
+                  waitingResponse_(false)
             {}
 
             // default copy-ctor, dtor and assignment are fine
@@ -49,15 +93,132 @@ namespace muduo
             void receiveRequestLine()    // 请求函已经接收完毕
             { state_ = kExpectHeaders; } // 下一个希望接受的是Headers
 
-            void receiveHeaders()       // Headers已经接收完毕
-            { state_ = kGotAll; }       // 当前没有处理Body，所以直接是kGotAll
+            void receiveHeaders()       // Headers已经接收完毕，没有body
+            { state_ = kGotAll; }
+
+            // Headers已经接收完毕，接下来是body
+            void receiveHeaders(BodyState first, size_t contentLength, bool stream)
+            {
+                state_ = kExpectBody;
+                bodyState_ = first;
+                bodyRemaining_ = contentLength;
+                streamBody_ = stream;
+            }
+
+            void receiveBody()          // body已经接收完毕
+            { state_ = kGotAll; }
+
+            BodyState bodyState() const
+            { return bodyState_; }
+
+            void setBodyState(BodyState s)
+            { bodyState_ = s; }
+
+            size_t bodyRemaining() const
+            { return bodyRemaining_; }
+
+            // 开始一个chunk，长度为0的是最后一个
+            void startChunk(size_t size)
+            {
+                bodyState_ = size > 0 ? kChunkData : kChunkTrailer;
+                bodyRemaining_ = size;
+            }
+
+            // 收到了n个字节的body
+            void consumeBody(size_t n)
+            {
+                assert(n <= bodyRemaining_);
+                bodyRemaining_ -= n;
+                if (bodyRemaining_ == 0 && bodyState_ == kChunkData) {
+                    bodyState_ = kChunkDataEnd;
+                }
+            }
+
+            bool streamBody() const
+            { return streamBody_; }
+
+            // 接下来要解析的是以CRLF结尾的一行
+            bool expectLine() const
+            {
+                return state_ == kExpectRequestLine || state_ == kExpectHeaders ||
+                       (state_ == kExpectBody &&
+                        (bodyState_ == kChunkSize || bodyState_ == kChunkTrailer));
+            }
+
+            void setSendContinue(bool on)
+            { sendContinue_ = on; }
+
+            // 是否要回复"100 Continue"，只回复一次
+            bool takeSendContinue()
+            {
+                bool on = sendContinue_;
+                sendContinue_ = false;
+                return on;
+            }
+
+            void setBodyTooLarge()
+            { bodyTooLarge_ = true; }
+
+            bool bodyTooLarge() const
+            { return bodyTooLarge_; }
+
+            size_t parsedBytes() const
+            { return parsed_; }
+
+            void setParsedBytes(size_t n)
+            { parsed_ = n; }
+
+            size_t scannedBytes() const
+            { return scanned_; }
+
+            void setScannedBytes(size_t n)
+            { scanned_ = n; }
+
+            void startResponseStream(const HttpResponse& response)
+            {
+                responseStream_ = response.bodyStream();
+                responseChunked_ = response.chunked();
+                closeAfterResponse_ = response.closeConnection();
+            }
+
+            void finishResponseStream()
+            { responseStream_ = HttpResponse::BodyStream(); }
+
+            bool streamingResponse() const
+            { return !responseStream_.empty(); }
+
+            const HttpResponse::BodyStream& responseStream() const
+            { return responseStream_; }
+
+            bool responseChunked() const
+            { return responseChunked_; }
+
+            bool closeAfterResponse() const
+            { return closeAfterResponse_; }
+
+            void setWaitingResponse(bool on)
+            { waitingResponse_ = on; }
+
+            bool waitingResponse() const
+            { return waitingResponse_; }
+
+            /// A streamed or deferred response has not finished, the requests
+            /// pipelined after it must wait.
+            bool responseInProgress() const
+            { return waitingResponse_ || streamingResponse(); }
 
             // 重置HttpContext状态
             void reset()
             {
                 state_ = kExpectRequestLine;
-                HttpRequest dummy;      // 新建一个空HttpRequest对象
-                request_.swap(dummy);   // 将当前对象request_置空
+                parsed_ = 0;
+                scanned_ = 0;
+                bodyState_ = kContentLength;
+                bodyRemaining_ = 0;
+                streamBody_ = false;
+                sendContinue_ = false;
+                bodyTooLarge_ = false;
+                request_.reset();       // 保留header数组的容量，给下一个请求用
             }
 
             const HttpRequest& request() const
@@ -8,36 +8,164 @@ HttpServer：http服务器类封装
 #define MUDUO_NET_HTTP_HTTPREQUEST_H
 
 #include <WebServer/base/copyable.h>
+#include <WebServer/base/StringPiece.h>
 #include <WebServer/base/Timestamp.h>
 #include <WebServer/base/Types.h>
 
+#include <boost/any.hpp>
 #include <map>
+#include <vector>
 #include <assert.h>
+#include <ctype.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <strings.h>    // strncasecmp
 
 namespace muduo
 {
     namespace net
     {
+        ///
+        /// A parsed request, path and headers are views into the raw request
+        /// (normally the connection's input buffer), strings are only built
+        /// when asked for with path(), getHeader() or headers().
+        ///
+        /// The views are valid while the request is being handled, call
+        /// materialize() to keep the request beyond that.
         class HttpRequest : public muduo::copyable
         {
-        private:
-            Method method_;         // 请求方法
-            Version version_;       // 协议版本1.0/1.1
-            string path_;           // 请求路径
-            TimeStamp receiveTime_; // 请求时间
-            std::map<string, string> headers_;  // header列表
-
         public:
             enum Method// http方法不止这些，此处没有完全实现
             { kInvalid, kGet, kPost, kHead, kPut, kDelete};
             enum Version// http版本
             { kUnknown, kHttp10, kHttp11};
 
+        private:
+            // 相对于请求起始位置的一段，请求在buffer中被搬移（makeSpace）之后仍然有效
+            struct Span
+            {
+                uint32_t offset;
+                uint32_t length;
+            };
+            struct HeaderSpan
+            {
+                Span field;
+                Span value;
+            };
+
+            Span span(const char* start, const char* end) const
+            {
+                assert(base_ != NULL && start >= base_ && end >= start);
+                Span s = { static_cast<uint32_t>(start - base_),
+                           static_cast<uint32_t>(end - start) };
+                return s;
+            }
+            StringPiece piece(Span s) const
+            { return StringPiece(base() + s.offset, static_cast<int>(s.length)); }
+            const char* base() const
+            { return owned_ ? storage_.data() : base_; }
+            string lowerField(size_t i) const
+            {
+                string f(piece(headers_[i].field).as_string());
+                for (size_t j = 0; j < f.size(); ++j) {
+                    f[j] = static_cast<char>(::tolower(static_cast<unsigned char>(f[j])));
+                }
+                return f;
+            }
+
+            Method method_;         // 请求方法
+            Version version_;       // 协议版本1.0/1.1
+            Span path_;             // 请求路径
+            Timestamp receiveTime_; // 请求时间
+            std::vector<HeaderSpan> headers_;   // header列表，按出现的顺序
+            const char* base_;      // 请求的起始位置，在input buffer中
+            size_t size_;           // 请求行、header（包括空行）和Content-Length的body的总长度
+            bool owned_;            // materialize()之后，请求的内容在storage_中
+            string storage_;
+            Span body_;             // Content-Length的body就在header之后，不拷贝
+            string bodyString_;     // chunked的body解码之后放在这里
+            bool bodyOwned_;        // body在bodyString_中
+            boost::any context_;    // 流式接收body时，用户回调保存自己的状态
+            // 按需构造的字符串
+            mutable string pathString_;
+            mutable bool pathBuilt_;
+            mutable std::map<string, string> headerMap_;
+            mutable bool headerMapBuilt_;
+
+        public:
+            static const size_t kInitialHeaders = 16;
+
             HttpRequest()
                 : method_(kInvalid),
-                  version_(kUnknown)
-            {}
+                  version_(kUnknown),
+                  base_(NULL),
+                  size_(0),
+                  owned_(false),
+                  bodyOwned_(false),
+                  pathBuilt_(false),
+                  headerMapBuilt_(false)
+            {
+                path_.offset = path_.length = 0;
+                body_.offset = body_.length = 0;
+            }
+
+            // default copy-ctor, dtor and assignment are fine
+            // 拷贝出来的对象与原对象引用同一段input buffer，除非已经materialize()
+
+            /// Clears the request for the next one on the connection,
+            /// keeps the capacity of the header array.
+            void reset()
+            {
+                method_ = kInvalid;
+                version_ = kUnknown;
+                path_.offset = path_.length = 0;
+                receiveTime_ = Timestamp();
+                headers_.clear();
+                base_ = NULL;
+                size_ = 0;
+                owned_ = false;
+                storage_.clear();
+                body_.offset = body_.length = 0;
+                bodyString_.clear();
+                bodyOwned_ = false;
+                context_ = boost::any();
+                pathString_.clear();
+                pathBuilt_ = false;
+                headerMap_.clear();
+                headerMapBuilt_ = false;
+            }
+
+            /// Parser only: where the raw request starts now, the offsets recorded
+            /// so far are relative to it. Called again whenever the input buffer
+            /// may have moved the data.
+            void setBase(const char* base)
+            {
+                assert(!owned_);
+                base_ = base;
+            }
+
+            bool materialized() const
+            { return owned_; }
+
+            /// Parser only: the request line, headers and the body kept in place
+            /// take @c size bytes from base.
+            void setSize(size_t size)
+            { size_ = size; }
+
+            size_t size() const
+            { return size_; }
+
+            /// Copies the raw request into the request itself (one allocation),
+            /// so it outlives the input buffer, e.g. for deferred handling.
+            void materialize()
+            {
+                if (!owned_ && base_ != NULL) {
+                    storage_.assign(base_, size_);
+                    owned_ = true;
+                    base_ = NULL;
+                }
+            }
 
             void setVersion(Version v)
             { version_ = v; }
@@ -47,8 +175,8 @@ namespace muduo
 
             bool setMethod(const char* start, const char* end)
             {
-                assert(method_ == kInvalid)
-                stirng m(start, end);
+                assert(method_ == kInvalid);
+                StringPiece m(start, static_cast<int>(end - start));
                 if (m == "GET")
                 { method_ = kGet; }
                 else if (m == "POST")
@@ -94,10 +222,23 @@ namespace muduo
             }
 
             void setPath(const char* start, const char* end)
-            { path_.assign(start, end); }
+            {
+                path_ = span(start, end);
+                pathBuilt_ = false;
+            }
+
+            /// Without building a string.
+            StringPiece pathPiece() const
+            { return piece(path_); }
 
             const string& path() const
-            { return path_; }
+            {
+                if (!pathBuilt_) {
+                    pathString_ = pathPiece().as_string();
+                    pathBuilt_ = true;
+                }
+                return pathString_;
+            }
 
             void setReceiveTime(Timestamp t)
             { receiveTime_ = t; }
@@ -107,43 +248,129 @@ namespace muduo
 
             ///
             /// @param colon 冒号位置
-            /// 
+            ///
             void addHeader(const char* start, const char* colon, const char* end)
             {
-                string field(start, colon); // header域
+                HeaderSpan h;
+                h.field = span(start, colon);   // header域
                 ++colon;
                 // 去除左空格
                 while (colon < end && isspace(*colon)) {
                     ++colon;
                 }
-                string value(colon, end);   // header值
                 // 去除右空格
-                while (!value.empty() && isspace(value[value.size()-1])) {
-                    value.resize(value.size()-1);
+                while (end > colon && isspace(*(end-1))) {
+                    --end;
+                }
+                h.value = span(colon, end);     // header值
+                if (headers_.capacity() == 0) {
+                    headers_.reserve(kInitialHeaders);
                 }
-                headers_[field] = value;
+                headers_.push_back(h);
+                headerMapBuilt_ = false;
             }
 
-            string getHeader(const string& field) const
+            /// Parser only: the body is [start, end) of the raw request.
+            void setBody(const char* start, const char* end)
+            {
+                body_ = span(start, end);
+                bodyOwned_ = false;
+            }
+
+            /// Parser only: appends decoded (chunked) body data.
+            void appendBody(const char* data, size_t len)
             {
-                string result;
-                std::map<string, string>::const_iterator it = headers_.find(field);
-                if (it != headers_.end()) {
-                    result = it->second;
+                bodyString_.append(data, len);
+                bodyOwned_ = true;
+            }
+
+            /// Empty if there is no body, or if it was streamed to the body callback.
+            StringPiece body() const
+            {
+                return bodyOwned_ ? StringPiece(bodyString_)
+                                  : piece(body_);
+            }
+
+            /// For the body callback to keep its state while the body is streamed,
+            /// the request handler reads it with getContext().
+            void setContext(const boost::any& context)
+            { context_ = context; }
+
+            const boost::any& getContext() const
+            { return context_; }
+
+            boost::any* getMutableContext()
+            { return &context_; }
+
+            /// Case-insensitive, the last one if @c field appears several times,
+            /// as getHeader() and headers() do.
+            /// @return whether found, @c value is set to a view into the request.
+            bool findHeader(const StringPiece& field, StringPiece* value) const
+            {
+                for (size_t i = headers_.size(); i-- > 0; ) {// 从后往前找，重复的header以最后一个为准
+                    const Span& f = headers_[i].field;
+                    if (f.length == static_cast<uint32_t>(field.size()) &&
+                        ::strncasecmp(base() + f.offset, field.data(), f.length) == 0) {
+                        *value = piece(headers_[i].value);
+                        return true;
+                    }
                 }
-                return result;
+                return false;
+            }
+
+            string getHeader(const string& field) const
+            {
+                StringPiece value;
+                return findHeader(field, &value) ? value.as_string() : string();
             }
 
+            size_t numHeaders() const
+            { return headers_.size(); }
+
+            StringPiece headerField(size_t i) const
+            { return piece(headers_[i].field); }
+
+            StringPiece headerValue(size_t i) const
+            { return piece(headers_[i].value); }
+
+            /// Builds a map on first call, prefer findHeader().
+            /// The keys are the fields as received, each maps to what getHeader()
+            /// returns for it, so duplicates differing only in case agree too.
             const std::map<string, string>& headers() const
-            { return headers_; }
+            {
+                if (!headerMapBuilt_) {
+                    headerMap_.clear();
+                    std::map<string, string> lastValue;// 小写的域名 -> 最后一个值
+                    for (size_t i = 0; i < headers_.size(); ++i) {
+                        lastValue[lowerField(i)] = headerValue(i).as_string();
+                    }
+                    for (size_t i = 0; i < headers_.size(); ++i) {
+                        headerMap_[headerField(i).as_string()] = lastValue[lowerField(i)];
+                    }
+                    headerMapBuilt_ = true;
+                }
+                return headerMap_;
+            }
 
             void swap(HttpRequest& that)
             {
                 std::swap(method_, that.method_);
-                // std::swap(version_, that.version_);
-                path_.swap(that.path_)
+                std::swap(version_, that.version_);
+                std::swap(path_, that.path_);
                 receiveTime_.swap(that.receiveTime_);
                 headers_.swap(that.headers_);
+                std::swap(base_, that.base_);
+                std::swap(size_, that.size_);
+                std::swap(owned_, that.owned_);
+                storage_.swap(that.storage_);
+                std::swap(body_, that.body_);
+                bodyString_.swap(that.bodyString_);
+                std::swap(bodyOwned_, that.bodyOwned_);
+                context_.swap(that.context_);
+                pathString_.swap(that.pathString_);
+                std::swap(pathBuilt_, that.pathBuilt_);
+                headerMap_.swap(that.headerMap_);
+                std::swap(headerMapBuilt_, that.headerMapBuilt_);
             }
 
         }; // class HttpRequest
@@ -151,4 +378,4 @@ namespace muduo
 } // namespace muduo
 
 
-#endif  // MUDUO_NET_HTTP_HTTPREQUEST_H
\ No newline at end of file
+#endif  // MUDUO_NET_HTTP_HTTPREQUEST_H
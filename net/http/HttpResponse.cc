@@ -6,7 +6,13 @@
 using namespace muduo;
 using namespace muduo::net;
 
-void HttpResponse::appendBuffer(Buffer* output) const
+void HttpResponse::appendToBuffer(Buffer* output) const
+{
+    appendHeaderToBuffer(output);
+    output->append(body_);
+}
+
+void HttpResponse::appendHeaderToBuffer(Buffer* output) const
 {
     char buf[32];
     // 添加响应头
@@ -15,7 +21,19 @@ void HttpResponse::appendBuffer(Buffer* output) const
     output->append(statusMessage_);
     output->append("\r\n");
 
-    if (closeConnection_) { // 如果是短连接，
+    if (streaming()) {      // 流式响应，长度事先知道就用Content-Length
+        if (chunked_) {
+            output->append("Transfer-Encoding: chunked\r\n");
+        }
+        else if (contentLength_ >= 0) {
+            snprintf(buf, sizeof buf, "Content-Length: %lld\r\n",
+                     static_cast<long long>(contentLength_));
+            output->append(buf);
+        }
+        output->append(closeConnection_ ? "Connection: close\r\n"
+                                        : "Connection: Keep-Alive\r\n");
+    }
+    else if (closeConnection_) { // 如果是短连接，
         // 不需要告诉浏览器Content-Length，浏览器也能正确处理
         output->append("Connection: close\r\n");
     }
@@ -39,5 +57,4 @@ void HttpResponse::appendBuffer(Buffer* output) const
     }
     
     output->append("\r\n");// header与body之间的空行
-    output->append(body_);
 }
\ No newline at end of file
@@ -10,8 +10,11 @@ HttpServer：http服务器类封装
 #include <WebServer/base/copyable.h>
 #include <WebServer/base/Types.h>
 
+#include <boost/function.hpp>
 #include <map>
 
+#include <stdint.h>
+
 namespace muduo
 {
     namespace net
@@ -26,6 +29,10 @@ namespace muduo
             string statusMessage_;				// 状态响应码对应的文本信息
             bool closeConnection_;				// 是否关闭连接
             string body_;						// 实体
+            // 流式响应
+            boost::function<bool (Buffer*)> bodyStream_;
+            int64_t contentLength_;             // 流式响应的总长度，-1表示事先不知道
+            bool chunked_;                      // 用chunked编码发送流式响应
 
         public:
             enum HttpStatusCode
@@ -35,11 +42,19 @@ namespace muduo
                 k301MovedPermanently = 301, // 301重定向，请求的页面永久性移至另一个地址
                 k400BadRequest = 400, // 错误的请求，语法格式有错，服务器无法处理此请求
                 k404NotFound = 404, // 请求的网页不存在
+                k503ServiceUnavailable = 503, // 服务器暂时无法处理（处理线程池的队列已满）
             };
 
+            /// Appends the next part of a streamed body to @c output,
+            /// returns false when the body is complete.
+            /// Must append something whenever it returns true.
+            typedef boost::function<bool (Buffer* output)> BodyStream;
+
             explicit HttpResponse(bool close)
                 : statusCode_(kUnknown),
-                  closeConnection_(close)
+                  closeConnection_(close),
+                  contentLength_(-1),
+                  chunked_(false)
             {}
 
             void setStatusCode(HttpStatusCode code)
@@ -65,10 +80,47 @@ namespace muduo
             void setBody(const string& body)
             { body_ = body; }
 
+            const string& body() const
+            { return body_; }
+
+            /// Streams the body instead of setBody(): @c stream is called in the IO
+            /// thread each time the previous part has been written out, so a large
+            /// body is generated piece by piece with bounded memory.
+            /// Without @c contentLength, HTTP/1.1 uses chunked encoding and
+            /// HTTP/1.0 closes the connection at the end.
+            void setBodyStream(const BodyStream& stream, int64_t contentLength = -1)
+            {
+                bodyStream_ = stream;
+                contentLength_ = contentLength;
+            }
+
+            bool streaming() const
+            { return !bodyStream_.empty(); }
+
+            const BodyStream& bodyStream() const
+            { return bodyStream_; }
+
+            int64_t contentLength() const
+            { return contentLength_; }
+
+            void setChunked(bool on)
+            { chunked_ = on; }
+
+            bool chunked() const
+            { return chunked_; }
+
+            /// Moves the body out without copying, e.g. to send it as a ChunkPtr.
+            void swapBody(string* body)
+            { body_.swap(*body); }
+
             // 将HttpResponse对象的信息打包成字符串添加到Buffer，
             // 以便发送给客户端
             void appendToBuffer(Buffer* output) const;
 
+            // 只添加状态行和header（包括header之后的空行），不包括body，
+            // body可以与之一起用TcpConnection::send(slices)发送，避免拷贝
+            void appendHeaderToBuffer(Buffer* output) const;
+
         }; // class HttpResponse
 
     } // namespace net
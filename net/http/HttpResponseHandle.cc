@@ -0,0 +1,33 @@
+#include <WebServer/net/http/HttpResponseHandle.h>
+
+#include <WebServer/base/Logging.h>
+#include <WebServer/net/EventLoop.h>
+#include <WebServer/net/TcpConnection.h>
+
+#include <boost/bind.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+
+HttpResponseHandle::HttpResponseHandle(const TcpConnectionPtr& conn,
+                                       const HttpRequest& request,
+                                       bool close,
+                                       const DoneCallback& cb)
+    : loop_(conn->getLoop()),
+      conn_(conn),
+      request_(request),
+      response_(close),
+      doneCallback_(cb)
+{
+    request_.materialize();// 原请求引用的input buffer在处理函数返回后就会被取回
+}
+
+void HttpResponseHandle::done()
+{
+    if (done_.getAndSet(1) != 0) {
+        LOG_WARN << "HttpResponseHandle::done() called more than once";
+        return;
+    }
+    // 总是放到队列中：在IO线程中同步调用done()时，前面的响应还没有发出去
+    loop_->queueInLoop(boost::bind(doneCallback_, shared_from_this()));
+}
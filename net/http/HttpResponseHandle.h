@@ -0,0 +1,82 @@
+/*
+HttpRequest：http请求类封装
+HttpResponse：http响应类封装
+HttpResponseHandle：延迟完成的响应，可以在任意线程完成
+HttpContext：http协议解析类
+HttpServer：http服务器类封装
+*/
+#ifndef MUDUO_NET_HTTP_HTTPRESPONSEHANDLE_H
+#define MUDUO_NET_HTTP_HTTPRESPONSEHANDLE_H
+
+#include <WebServer/base/Atomic.h>
+#include <WebServer/net/Callbacks.h>
+#include <WebServer/net/http/HttpRequest.h>
+#include <WebServer/net/http/HttpResponse.h>
+
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+namespace muduo
+{
+    namespace net
+    {
+        class EventLoop;
+
+        ///
+        /// A response the handler completes later, from any thread, by filling
+        /// response() and calling done().
+        ///
+        /// The handle owns a copy of the request, so it can be kept after the
+        /// handler returns. The server answers the requests of a connection in
+        /// order, the ones pipelined after this one wait until it is done.
+        /// If the connection is gone by then, the response is dropped.
+        class HttpResponseHandle : boost::noncopyable,
+                                   public boost::enable_shared_from_this<HttpResponseHandle>
+        {
+        public:
+            typedef boost::function<void (const boost::shared_ptr<HttpResponseHandle>&)> DoneCallback;
+
+        private:
+            EventLoop* loop_;                       // 连接所属的IO线程
+            boost::weak_ptr<TcpConnection> conn_;   // 不延长连接的生命期
+            HttpRequest request_;                   // materialize()之后的拷贝
+            HttpResponse response_;
+            DoneCallback doneCallback_;             // 在loop_中调用
+            AtomicInt32 done_;
+
+        public:
+            HttpResponseHandle(const TcpConnectionPtr& conn,
+                               const HttpRequest& request,
+                               bool close,
+                               const DoneCallback& cb);
+
+            const HttpRequest& request() const
+            { return request_; }
+
+            /// Fill it before done(), do not touch it afterwards.
+            HttpResponse* response()
+            { return &response_; }
+
+            /// Sends the response in the connection's loop. Thread safe,
+            /// only the first call counts.
+            void done();
+
+            bool isDone()
+            { return done_.get() != 0; }
+
+            /// Null if the connection has been closed.
+            TcpConnectionPtr connection() const
+            { return conn_.lock(); }
+
+        }; // class HttpResponseHandle
+
+        typedef boost::shared_ptr<HttpResponseHandle> HttpResponseHandlePtr;
+
+    } // namespace net
+
+} // namespace muduo
+
+#endif  // MUDUO_NET_HTTP_HTTPRESPONSEHANDLE_H
@@ -1,11 +1,22 @@
 #include <WebServer/net/http/HttpServer.h>
 
 #include <WebServer/base/Logging.h>
+#include <WebServer/base/ThreadPool.h>
+#include <WebServer/net/CharScan.h>
 #include <WebServer/net/http/HttpContext.h>
 #include <WebServer/net/http/HttpRequest.h>
 #include <WebServer/net/http/HttpResponse.h>
+#include <WebServer/net/http/HttpResponseHandle.h>
 
 #include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
+#include <algorithm>
+#include <vector>
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>    // strncasecmp
 
 using namespace muduo;
 using namespace muduo::net;
@@ -21,11 +32,11 @@ namespace muduo
             {
                 bool succeed = false;
                 const char* start = begin;
-                const char* space = std::find(start, end, ' ');
+                const char* space = scan::findChar(start, end, ' ');
                 HttpRequest& request = context->request();     // 取出请求对象
                 if (space != end && request.setMethod(start, space)) {   // 解析请求方法
                     start = space + 1;
-                    space = std::find(start, end, ' ');
+                    space = scan::findChar(start, end, ' ');
                     if (space != end) {
                         request.setPath(start, space);  // 解析PATH
                         start = space + 1;
@@ -46,55 +57,352 @@ namespace muduo
                 return succeed;
             }
 
+            // 查找当前行的结尾，从上次停下的位置继续，每个字节只扫描一次
+            const char* findLineEnd(Buffer* buf, HttpContext* context)
+            {
+                const char* begin = buf->peek() + context->parsedBytes();
+                const char* start = buf->peek() + context->scannedBytes();
+                if (start > begin) {
+                    --start;    // 上次的最后一个字节可能是'\r'
+                }
+                else {
+                    start = begin;
+                }
+                const char* crlf = buf->findCRLF(start);
+                context->setScannedBytes(crlf ? 0 : buf->readableBytes());
+                return crlf;
+            }
+
+            bool equalsIgnoreCase(const StringPiece& s, const char* lit)
+            {
+                size_t len = strlen(lit);
+                return static_cast<size_t>(s.size()) == len &&
+                       ::strncasecmp(s.data(), lit, len) == 0;
+            }
+
+            // Content-Length：只允许十进制数字
+            bool parseContentLength(const StringPiece& s, size_t* length)
+            {
+                if (s.empty() || s.size() > 18) {   // 不会溢出
+                    return false;
+                }
+                size_t n = 0;
+                for (int i = 0; i < s.size(); ++i) {
+                    if (s[i] < '0' || s[i] > '9') {
+                        return false;
+                    }
+                    n = n * 10 + (s[i] - '0');
+                }
+                *length = n;
+                return true;
+            }
+
+            // chunk长度行：十六进制数字，后面可以有";extension"
+            bool parseChunkSize(const char* begin, const char* end, size_t* size)
+            {
+                size_t n = 0;
+                const char* p = begin;
+                for (; p < end && isxdigit(*p); ++p) {
+                    if (p - begin >= 15) {  // 不会溢出
+                        return false;
+                    }
+                    n = n * 16 + (isdigit(*p) ? *p - '0' : (tolower(*p) - 'a' + 10));
+                }
+                if (p == begin || (p < end && *p != ';' && *p != ' ' && *p != '\t')) {
+                    return false;
+                }
+                *size = n;
+                return true;
+            }
+
+            // header解析完毕，根据Transfer-Encoding和Content-Length决定怎样接收body
+            bool startBody(Buffer* buf, HttpContext* context,
+                           size_t maxBodySize, const HttpServer::HttpBodyCallback& onBody)
+            {
+                HttpRequest& request = context->request();
+                request.setSize(context->parsedBytes());
+                StringPiece value;
+                bool chunked = false;
+                size_t length = 0;
+                if (request.findHeader("Transfer-Encoding", &value)) {
+                    // 只支持chunked；同时带有Content-Length的请求可能是请求走私，拒绝
+                    if (!equalsIgnoreCase(value, "chunked") ||
+                        request.findHeader("Content-Length", &value)) {
+                        return false;
+                    }
+                    chunked = true;
+                }
+                else if (request.findHeader("Content-Length", &value) &&
+                         !parseContentLength(value, &length)) {
+                    return false;
+                }
+                if (!chunked && length == 0) {
+                    context->receiveHeaders();  // 没有body
+                    return true;
+                }
+
+                const bool stream = !onBody.empty();
+                if (!stream && length > maxBodySize) {
+                    context->setBodyTooLarge();
+                    return false;
+                }
+                if (request.findHeader("Expect", &value) && equalsIgnoreCase(value, "100-continue")) {
+                    context->setSendContinue(true);
+                }
+                if (stream || chunked) {
+                    // body到一点取走一点，不能再让header引用buf：拷贝一次header，从buf中取走
+                    request.materialize();
+                    buf->retrieve(context->parsedBytes());
+                    context->setParsedBytes(0);
+                    context->setScannedBytes(0);
+                }
+                context->receiveHeaders(chunked ? HttpContext::kChunkSize : HttpContext::kContentLength,
+                                        length, stream);
+                return true;
+            }
+
+            // 交出一段body：流式的交给回调，chunked的解码到请求中
+            bool deliverBody(HttpContext* context, const char* data, size_t len,
+                             size_t maxBodySize, const HttpServer::HttpBodyCallback& onBody)
+            {
+                HttpRequest& request = context->request();
+                if (context->streamBody()) {
+                    onBody(&request, StringPiece(data, static_cast<int>(len)));
+                }
+                else if (request.body().size() + len > maxBodySize) {
+                    context->setBodyTooLarge();
+                    return false;
+                }
+                else {
+                    request.appendBody(data, len);
+                }
+                return true;
+            }
+
+            // return false if any error, *hasMore is set to false if more data is needed
+            bool parseBody(Buffer* buf, HttpContext* context, bool* hasMore,
+                           size_t maxBodySize, const HttpServer::HttpBodyCallback& onBody)
+            {
+                HttpRequest& request = context->request();
+                const char* begin = buf->peek() + context->parsedBytes();
+                const size_t avail = buf->readableBytes() - context->parsedBytes();
+                const size_t n = std::min(avail, context->bodyRemaining());
+                switch (context->bodyState())
+                {
+                    case HttpContext::kContentLength:
+                        if (context->streamBody()) {
+                            if (n > 0) {
+                                onBody(&request, StringPiece(begin, static_cast<int>(n)));
+                                buf->retrieve(n);
+                                context->consumeBody(n);
+                            }
+                        }
+                        else if (n == context->bodyRemaining()) {   // body都到了，留在buf中
+                            request.setBody(begin, begin + n);
+                            context->setParsedBytes(context->parsedBytes() + n);
+                            request.setSize(context->parsedBytes());
+                            context->consumeBody(n);
+                        }
+                        if (context->bodyRemaining() == 0) {
+                            context->receiveBody();
+                        }
+                        *hasMore = false;
+                        return true;
+
+                    case HttpContext::kChunkSize:
+                    {
+                        const char* crlf = findLineEnd(buf, context);
+                        if (!crlf) {
+                            *hasMore = false;
+                            return true;
+                        }
+                        size_t size = 0;
+                        if (!parseChunkSize(begin, crlf, &size)) {
+                            return false;
+                        }
+                        buf->retrieveUntil(crlf + 2);
+                        context->startChunk(size);
+                        return true;
+                    }
+
+                    case HttpContext::kChunkData:
+                        if (n == 0) {
+                            *hasMore = false;
+                            return true;
+                        }
+                        if (!deliverBody(context, begin, n, maxBodySize, onBody)) {
+                            return false;
+                        }
+                        buf->retrieve(n);
+                        context->consumeBody(n);
+                        return true;
+
+                    case HttpContext::kChunkDataEnd:
+                        if (avail < 2) {
+                            *hasMore = false;
+                            return true;
+                        }
+                        if (begin[0] != '\r' || begin[1] != '\n') {
+                            return false;
+                        }
+                        buf->retrieve(2);
+                        context->setBodyState(HttpContext::kChunkSize);
+                        return true;
+
+                    case HttpContext::kChunkTrailer:   // trailer中的header忽略
+                    {
+                        const char* crlf = findLineEnd(buf, context);
+                        if (!crlf) {
+                            *hasMore = false;
+                            return true;
+                        }
+                        bool emptyLine = crlf == begin;
+                        buf->retrieveUntil(crlf + 2);
+                        if (emptyLine) {
+                            context->receiveBody();
+                            *hasMore = false;
+                        }
+                        return true;
+                    }
+                }
+                return false;
+            }
+
             // FIXME: move to HttpContext class
             // return false if any error
-            bool parseRequest(Buffer* buf, HttpContext* context, Timestamp receiveTime)
+            // 解析过的行留在buf中，request引用其中的数据，处理完请求之后才retrieve
+            // 流式接收或者chunked的body例外，边解析边从buf中取走
+            bool parseRequest(Buffer* buf, HttpContext* context, Timestamp receiveTime,
+                              size_t maxBodySize, const HttpServer::HttpBodyCallback& onBody)
             {
                 bool ok = true;
                 bool hasMore = true;
-                while (hasMore)
+                HttpRequest& request = context->request();
+                if (!request.materialized()) {
+                    request.setBase(buf->peek());   // 上次调用之后buf中的数据可能被搬移过
+                }
+                while (ok && hasMore)
                 {
+                    const char* begin = buf->peek() + context->parsedBytes();// 下一行的起始位置
                     if (context->expectRequestLine()) { // 处于解析请求行状态
-                        const char* crlf = buf->findCRLF();// 首先查找/r/n，并指向/r的位置
+                        const char* crlf = findLineEnd(buf, context);// 首先查找/r/n，并指向/r的位置
                         if (crlf) { // 查找到了/r/n
-                            ok = processRequestLine(buf->peek(), crlf, context);    // 解析请求行
+                            ok = processRequestLine(begin, crlf, context);    // 解析请求行
                             if (ok) {
-                                context->request().setReceiveTime(receiveTime); // 设置请求时间
-                                buf->retrieveUntil(crlf + 2);   // 将请求行从buf中取回，包括/r/n
+                                request.setReceiveTime(receiveTime); // 设置请求时间
+                                context->setParsedBytes(crlf + 2 - buf->peek());// 跳过请求行，包括/r/n
                                 context->receiveRequestLine();  // HttpContext将状态改为kExpectHeaders
                             }
-                            else {
-                                hasMore = false;
-                            }
                         }
                         else {
                             hasMore = false;
                         }
                     }
                     else if (context->expectHeaders()) {    // 解析Header
-                        const char* crlf = buf->findCRLF();
+                        const char* crlf = findLineEnd(buf, context);
                         if (crlf) { // 查找到了/r/n
-                            const char* colon = std::find(buf->peek(), crlf, ':');  // 冒号所在位置
+                            context->setParsedBytes(crlf + 2 - buf->peek());// 跳过Header，包括/r/n
+                            const char* colon = scan::findChar(begin, crlf, ':');  // 冒号所在位置
                             if (colon != crlf) {
-                                context->request().addHeader(buf->peek(), colon, crlf);
+                                // header域必须是非空的token
+                                ok = colon != begin && scan::findNonToken(begin, colon) == colon;
+                                if (ok) {
+                                    request.addHeader(begin, colon, crlf);
+                                }
                             }
                             else { // empty line, end of header
-                                context->receiveHeaders();      // HttpContext将状态改为kGotAll
-                                hasMore = !context->gotAll();
+                                ok = startBody(buf, context, maxBodySize, onBody);
                             }
-                            buf->retrieveUntil(crlf + 2);   // 将Header从buf中取回，包括/r/n
                         }
                         else {
                             hasMore = false;
                         }
                     }
-                    else if (context->expectBody()) {   // 当前还不支持请求中带body
-                        // FIXME;
+                    else if (context->expectBody()) {   // 解析body
+                        ok = parseBody(buf, context, &hasMore, maxBodySize, onBody);
+                    }
+                    else {  // kGotAll
+                        hasMore = false;
                     }
                 }
+                // 迟迟不结束的header（慢速客户端或者攻击），不再等下去
+                // 请求行和header解析之后都留在buf中，限制的是总长度，否则不断发送短header就能一直占用内存
+                // chunk的长度行和trailer边解析边取走，只限制还没结束的一行
+                if (ok && (context->expectRequestLine() || context->expectHeaders())) {
+                    ok = buf->readableBytes() <= HttpContext::kMaxHeaderBytes;
+                }
+                else if (ok && context->expectLine() &&
+                         buf->readableBytes() - context->parsedBytes() > HttpContext::kMaxHeaderBytes) {
+                    ok = false;
+                }
                 return ok;
             }
 
+            // 一次onMessage中所有（流水线）请求的响应，按顺序攒在一起，最后一次发送
+            // header和小的body拷贝到一个Buffer中，大的body按引用挂上去
+            class ResponseBatch : boost::noncopyable
+            {
+            private:
+                Buffer small_;
+                std::vector<ChunkPtr> chunks_;
+                int numResponses_;
+
+                void flushSmall()
+                {
+                    if (small_.readableBytes() > 0) {
+                        chunks_.push_back(ChunkPtr(new string(small_.retrieveAllAsString())));
+                    }
+                }
+
+            public:
+                static const size_t kMaxCopiedBody = 4096;   // 不超过这个长度的body直接拷贝
+
+                ResponseBatch() : numResponses_(0) {}
+
+                void append(HttpResponse* response)
+                {
+                    response->appendHeaderToBuffer(&small_);
+                    if (response->body().size() <= kMaxCopiedBody) {
+                        small_.append(response->body());
+                    }
+                    else {
+                        flushSmall();
+                        string* body = new string;
+                        response->swapBody(body);
+                        chunks_.push_back(ChunkPtr(body));
+                    }
+                    ++numResponses_;
+                }
+
+                void append(const StringPiece& raw)
+                { small_.append(raw); }
+
+                int numResponses() const
+                { return numResponses_; }
+
+                void send(const TcpConnectionPtr& conn)
+                {
+                    if (chunks_.empty()) {  // 都是小响应，直接从Buffer发送
+                        if (small_.readableBytes() > 0) {
+                            conn->send(&small_);
+                        }
+                    }
+                    else {                  // 一次writev
+                        flushSmall();
+                        conn->send(chunks_);
+                        chunks_.clear();
+                    }
+                }
+            };
+
+            // 在处理线程池中执行
+            void runPooledHandler(const HttpServer::HttpCallback& cb,
+                                  const HttpResponseHandlePtr& handle)
+            {
+                cb(handle->request(), handle->response());
+                handle->done();
+            }
+
             void defaultHttpCallback(const HttpRequest&, HttpResponse* resp)
             {
                 resp->setStatusCode(HttpResponse::k404NotFound);
@@ -113,12 +421,16 @@ HttpServer::HttpServer(EventLoop* loop,
                        const InetAddress& listenAddr,
                        const string& name)
     : server_(loop, listenAddr, name),
-      httpCallback_(detail::defaultHttpCallback)
+      httpCallback_(detail::defaultHttpCallback),
+      handlerPool_(NULL),
+      maxBodySize_(kDefaultMaxBodySize)
 {
     server_.setConnectionCallback(
         boost::bind(&HttpServer::onConnection, this, _1));
     server_.setMessageCallback(
         boost::bind(&HttpServer::onMessage, this, _1, _2, _3));
+    server_.setWriteCompleteCallback(
+        boost::bind(&HttpServer::onWriteComplete, this, _1));
 }
 
 HttpServer::~HttpServer()
@@ -145,30 +457,195 @@ void HttpServer::onMessage(const TcpConnectionPtr &conn,
     // 取出http上下文
     HttpContext* context = boost::any_cast<HttpContext>(conn->getMutableContext());
 
-    if (!detail::parseRequest(buf, context, receiveTime)) {
-        conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
-        conn->shutdown();
+    if (context->responseInProgress()) {
+        // 流式或者延迟完成的响应结束之后再处理后面的请求，积压太多就暂停读
+        if (buf->readableBytes() > HttpContext::kMaxHeaderBytes) {
+            conn->stopRead();
+        }
+        return;
     }
+    handleRequests(conn, context, buf, receiveTime);
+}
 
-    // 请求消息解析完毕
-    if (context->gotAll()) {
-        onRequest(conn, context->request());
-        context->reset();   // 本次请求处理完毕，重置HttpContext，适用于长连接
+void HttpServer::handleRequests(const TcpConnectionPtr& conn,
+                                HttpContext* context,
+                                Buffer* buf,
+                                Timestamp receiveTime)
+{
+    // 处理buf中所有完整的请求（HTTP/1.1流水线），响应按请求的顺序一起发送
+    detail::ResponseBatch batch;
+    bool close = false;
+    while (!close && !context->responseInProgress()) {
+        bool ok = detail::parseRequest(buf, context, receiveTime, maxBodySize_, httpBodyCallback_);
+        if (context->takeSendContinue()) {
+            batch.append("HTTP/1.1 100 Continue\r\n\r\n");
+        }
+        if (!ok) {
+            batch.append(context->bodyTooLarge() ? "HTTP/1.1 413 Payload Too Large\r\n\r\n"
+                                                 : "HTTP/1.1 400 Bad Request\r\n\r\n");
+            close = true;
+        }
+        else if (context->gotAll()) {   // 请求消息解析完毕
+            close = onRequest(conn, context, &batch);
+            buf->retrieve(context->parsedBytes());// request引用的数据到这里才从buf中取回
+            context->reset();   // 本次请求处理完毕，重置HttpContext，适用于长连接
+        }
+        else {
+            break;  // 剩下的不是一个完整的请求，等更多的数据
+        }
+    }
+    // 有流式响应时，body在这一批发送完毕之后（onWriteComplete）开始
+    batch.send(conn);
+    if (close) {
+        buf->retrieveAll(); // 要关闭的连接上后面的请求不再处理
+        conn->shutdown();
     }
 }
 
-void HttpServer::onRequest(const TcpConnectionPtr& conn, const HttpRequest& req)
+bool HttpServer::onRequest(const TcpConnectionPtr& conn,
+                           HttpContext* context,
+                           detail::ResponseBatch* batch)
 {
-    const string& connection = req.getHeader("Connection");
-    bool close = connection == "close" || 
-        (req.getVersion() == HttpRequest::kHttp10 && connection != "Keep-Alive");
+    const HttpRequest& req = context->request();
+    StringPiece connection;
+    req.findHeader("Connection", &connection);// 不构造string
+    bool close = connection == "close" ||
+        (req.getVersion() == HttpRequest::kHttp10 && !(connection == "Keep-Alive"));
+    if (handlerPool_ && !pooledHandlers_.empty()) {
+        std::map<string, HttpCallback>::const_iterator it = pooledHandlers_.find(req.path());
+        if (it != pooledHandlers_.end()) {
+            runInPool(conn, context, close, it->second);
+            return false;
+        }
+    }
+    if (httpAsyncCallback_) {
+        // 响应在onResponseDone中发送，在那之前后面（流水线）的请求不处理
+        HttpResponseHandlePtr handle(new HttpResponseHandle(
+            conn, req, close, boost::bind(&HttpServer::onResponseDone, this, _1)));
+        context->setWaitingResponse(true);
+        httpAsyncCallback_(handle);
+        return false;
+    }
     HttpResponse response(close);
     httpCallback_(req, &response);// 回调用户函数，对这个httpRequest进行相应的处理，并且返回一个response对象
-    Buffer buf;
-    response.appendToBuffer(&buf);// 将response对象转换成字符串添加到缓冲区buf当中
-    conn->send(&buf);// 将缓冲区发送给客户端
-    if (response.closeConnection()) {
-        conn->shutdown();
+    return appendResponse(context, req.getVersion(), &response, batch);
+}
+
+// 与延迟完成的响应相同，只是由处理线程池完成
+void HttpServer::runInPool(const TcpConnectionPtr& conn,
+                           HttpContext* context,
+                           bool close,
+                           const HttpCallback& cb)
+{
+    HttpResponseHandlePtr handle(new HttpResponseHandle(
+        conn, context->request(), close, boost::bind(&HttpServer::onResponseDone, this, _1)));
+    context->setWaitingResponse(true);
+    if (!handlerPool_->tryRun(boost::bind(&detail::runPooledHandler, cb, handle))) {
+        LOG_WARN << "HttpServer::runInPool - " << handlerPool_->name()
+                 << " is full, reject " << context->request().path();
+        HttpResponse* response = handle->response();
+        response->setStatusCode(HttpResponse::k503ServiceUnavailable);
+        response->setStatusMessage("Service Unavailable");
+        handle->done();
     }
 }
 
+// 响应追加到batch中，返回是否要关闭连接
+bool HttpServer::appendResponse(HttpContext* context,
+                                HttpRequest::Version version,
+                                HttpResponse* response,
+                                detail::ResponseBatch* batch)
+{
+    if (response->streaming()) {
+        if (response->contentLength() < 0) {
+            if (version == HttpRequest::kHttp11) {
+                response->setChunked(true);
+            }
+            else {  // HTTP/1.0不支持chunked，以关闭连接表示body结束
+                response->setCloseConnection(true);
+            }
+        }
+        batch->append(response);// 只有header
+        context->startResponseStream(*response);
+        return false;   // 要关闭的话，在流式响应发送完之后关闭
+    }
+    batch->append(response);
+    return response->closeConnection();
+}
+
+void HttpServer::onResponseDone(const HttpResponseHandlePtr& handle)
+{
+    TcpConnectionPtr conn = handle->connection();
+    if (!conn || !conn->connected()) {
+        return;     // 连接已经断开，响应丢弃
+    }
+    HttpContext* context = boost::any_cast<HttpContext>(conn->getMutableContext());
+    assert(context->waitingResponse());
+    context->setWaitingResponse(false);
+
+    detail::ResponseBatch batch;
+    bool close = appendResponse(context, handle->request().getVersion(),
+                                handle->response(), &batch);
+    batch.send(conn);
+    resumeRequests(conn, context, close);
+}
+
+void HttpServer::onWriteComplete(const TcpConnectionPtr& conn)
+{
+    HttpContext* context = boost::any_cast<HttpContext>(conn->getMutableContext());
+    if (context && context->streamingResponse()) {
+        pumpResponseStream(conn, context);
+    }
+}
+
+// 之前的输出都写出去了，再生成下一段，每个连接最多占用kStreamBytesPerWrite左右的内存
+void HttpServer::pumpResponseStream(const TcpConnectionPtr& conn, HttpContext* context)
+{
+    Buffer output;
+    bool more = true;
+    while (more && output.readableBytes() < kStreamBytesPerWrite) {
+        size_t before = output.readableBytes();
+        more = context->responseStream()(&output);
+        if (more && output.readableBytes() == before) {
+            LOG_ERROR << "HttpServer::pumpResponseStream - body stream appended nothing";
+            context->finishResponseStream();
+            conn->forceClose();// 响应已经无法正确结束
+            return;
+        }
+    }
+
+    if (context->responseChunked()) {
+        // 这一段作为一个chunk，与长度行和结尾一起writev，不拷贝
+        char sizeLine[32];
+        int n = 0;
+        if (output.readableBytes() > 0) {
+            n = snprintf(sizeLine, sizeof sizeLine, "%zx\r\n", output.readableBytes());
+        }
+        const char* tail = more ? "\r\n" : (output.readableBytes() > 0 ? "\r\n0\r\n\r\n" : "0\r\n\r\n");
+        StringPiece slices[3] = { StringPiece(sizeLine, n), output.toStringPiece(), tail };
+        conn->send(slices, 3);
+    }
+    else if (output.readableBytes() > 0) {
+        conn->send(&output);
+    }
+
+    if (!more) {
+        context->finishResponseStream();
+        resumeRequests(conn, context, context->closeAfterResponse());
+    }
+}
+
+// 流式或者延迟完成的响应结束之后，处理在此期间到达的请求
+void HttpServer::resumeRequests(const TcpConnectionPtr& conn, HttpContext* context, bool close)
+{
+    if (close) {
+        conn->inputBuffer()->retrieveAll();
+        conn->shutdown();
+    }
+    else if (!context->responseInProgress()) {
+        if (!conn->isReading()) {
+            conn->startRead();  // onMessage中因为积压暂停了读
+        }
+        handleRequests(conn, context, conn->inputBuffer(), Timestamp::now());
+    }
+}
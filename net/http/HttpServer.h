@@ -8,31 +8,76 @@ HttpServer：http服务器类封装
 #define MUDUO_NET_HTTP_HTTPSERVER_H
 
 #include <WebServer/net/TcpServer.h>
+#include <WebServer/net/http/HttpResponseHandle.h>
+#include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
+#include <map>
 
 namespace muduo
 {
+    class ThreadPool;
+
     namespace net
     {
+        class HttpContext;
         class HttpRequest;
         class HttpResponse;
 
+        namespace detail
+        {
+            class ResponseBatch;
+        }
+
         class HttpServer : boost::noncopyable
         {
+        public:
+            typedef boost::function<void (const HttpRequest&, 
+                                          HttpResponse*)> HttpCallback;
+            /// Receives the request body piece by piece as it arrives, the
+            /// pieces are views into the input buffer, valid during the call.
+            typedef boost::function<void (HttpRequest*,
+                                          const StringPiece& data)> HttpBodyCallback;
+            /// Handles the request without blocking the IO thread: fill
+            /// handle->response() and call handle->done(), now or later from
+            /// any thread.
+            typedef boost::function<void (const HttpResponseHandlePtr& handle)> HttpAsyncCallback;
+
         private:
             TcpServer     server_;
             HttpCallback  httpCallback_; // 在处理http请求（即调用onRequest）的过程中回调此函数，对请求进行具体的处理
+            HttpBodyCallback httpBodyCallback_;// 设置了就流式接收body，不在内存中攒起来
+            HttpAsyncCallback httpAsyncCallback_;// 设置了就代替httpCallback_，响应延迟完成
+            ThreadPool*   handlerPool_;  // 不属于HttpServer
+            std::map<string, HttpCallback> pooledHandlers_;// 按路径，在handlerPool_中执行的处理函数
+            size_t        maxBodySize_;  // 不流式接收时body的长度上限
 
             void onConnection(const TcpConnectionPtr& conn);
             void onMessage(const TcpConnectionPtr& conn,
                            Buffer* buf,
                            TimeStamp receiveTime);
-            void onRequest(const TcpConnectionPtr&, const HttpRequest&);
+            void handleRequests(const TcpConnectionPtr& conn,
+                                HttpContext* context,
+                                Buffer* buf,
+                                Timestamp receiveTime);
+            // 响应追加到batch中，返回是否要关闭连接
+            bool onRequest(const TcpConnectionPtr&, HttpContext* context, detail::ResponseBatch* batch);
+            void runInPool(const TcpConnectionPtr& conn,
+                           HttpContext* context,
+                           bool close,
+                           const HttpCallback& cb);
+            bool appendResponse(HttpContext* context,
+                                HttpRequest::Version version,
+                                HttpResponse* response,
+                                detail::ResponseBatch* batch);
+            void onResponseDone(const HttpResponseHandlePtr& handle);
+            void onWriteComplete(const TcpConnectionPtr& conn);
+            void pumpResponseStream(const TcpConnectionPtr& conn, HttpContext* context);
+            void resumeRequests(const TcpConnectionPtr& conn, HttpContext* context, bool close);
 
         public:
-            typedef boost::function<void (const HttpRequest&, 
-                                          HttpResponse*)> HttpCallback;
-            
+            static const size_t kDefaultMaxBodySize = 1024 * 1024;
+            static const size_t kStreamBytesPerWrite = 64 * 1024;// 流式响应每次生成的数据量
+
             HttpServer(EventLoop* loop,
                        const InetAddress& listenAddr,
                        const string& name);
@@ -46,6 +91,44 @@ namespace muduo
                 httpCallback_ = cb;
             }
 
+            /// Replaces the HttpCallback, see HttpResponseHandle.
+            /// Not thread safe, call before start().
+            void setHttpAsyncCallback(const HttpAsyncCallback& cb) {
+                httpAsyncCallback_ = cb;
+            }
+
+            /// Requests for the paths added with addPooledHandler() run in @c pool,
+            /// which must be started and outlive the server. When its queue is
+            /// full they get 503 right away, the IO thread never waits.
+            /// ThreadPool::stats() has the queue depth and wait times.
+            /// Not thread safe, call before start().
+            void setHandlerPool(ThreadPool* pool) {
+                handlerPool_ = pool;
+            }
+
+            /// Handles requests for exactly @c path with @c cb in the handler
+            /// pool, the response is sent from the connection's IO thread in
+            /// request order. Takes precedence over the other callbacks.
+            /// Not thread safe, call before start().
+            void addPooledHandler(const string& path, const HttpCallback& cb) {
+                pooledHandlers_[path] = cb;
+            }
+
+            /// Streams request bodies (Content-Length or chunked) to @c cb as they
+            /// arrive, without keeping them, then calls the HttpCallback with an
+            /// empty body. @c cb can keep its state with HttpRequest::setContext().
+            /// Without it, bodies are buffered and HttpRequest::body() has them.
+            /// Not thread safe, call before start().
+            void setHttpBodyCallback(const HttpBodyCallback& cb) {
+                httpBodyCallback_ = cb;
+            }
+
+            /// Requests with a larger buffered body get 413.
+            /// Not thread safe, call before start().
+            void setMaxBodySize(size_t size) {
+                maxBodySize_ = size;
+            }
+
             // 支持多线程
             void setThreadNum(int numThreads) {
                 server_.setThreadNum(numThreads);
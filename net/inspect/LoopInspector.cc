@@ -0,0 +1,37 @@
+#include <WebServer/net/inspect/LoopInspector.h>
+#include <WebServer/net/EventLoop.h>
+#include <WebServer/net/EventLoopThreadPool.h>
+
+#include <boost/bind.hpp>
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+LoopInspector::LoopInspector(EventLoopThreadPool* pool)
+    : pool_(pool)
+{
+}
+
+void LoopInspector::registerCommands(Inspector *ins)
+{
+    ins->add("loop", "placement", boost::bind(&LoopInspector::loops, this, _1, _2),
+             "list IO threads: tid, cpu, numa node, connections, busy");
+}
+
+string LoopInspector::loops(HttpRequest::Method, const Inspector::ArgList &)
+{
+    // start()之后loops不再变化，各项数值都可以跨线程读取
+    std::vector<EventLoop*> loops = pool_->loops();
+    string result = "loop\ttid\tcpu\tnode\tconns\tbusy\n";
+    for (size_t i = 0; i < loops.size(); ++i) {
+        EventLoop* loop = loops[i];
+        int busy = loop->busyPermille();
+        char buf[128];
+        snprintf(buf, sizeof buf, "%zu\t%d\t%d\t%d\t%d\t%d.%d%%\n",
+                 i, loop->threadId(), loop->cpu(), loop->numaNode(),
+                 loop->numConnections(), busy / 10, busy % 10);
+        result += buf;
+    }
+    return result;
+}
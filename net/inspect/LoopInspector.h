@@ -0,0 +1,29 @@
+#ifndef MUDUO_NET_INSPECT_LOOPINSPECTOR_H
+#define MUDUO_NET_INSPECT_LOOPINSPECTOR_H
+
+#include <WebServer/net/inspect/Inspector.h>
+#include <boost/noncopyable.hpp>
+namespace muduo
+{
+    namespace net
+    {
+        class EventLoopThreadPool;
+
+        // 输出IO线程的位置（CPU、NUMA节点）和负载
+        class LoopInspector : boost::noncopyable
+        {
+        private:
+            string loops(HttpRequest::Method, const Inspector::ArgList&);
+
+            EventLoopThreadPool* pool_;
+        public:
+            explicit LoopInspector(EventLoopThreadPool* pool);
+            // 注册命令接口，pool必须已经start
+            void registerCommands(Inspector* ins);
+        }; // class LoopInspector
+        
+    } // namespace net
+    
+} // namespace muduo
+
+#endif // MUDUO_NET_INSPECT_LOOPINSPECTOR_H
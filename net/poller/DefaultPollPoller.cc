@@ -0,0 +1,27 @@
+#include <WebServer/base/Logging.h>
+#include <WebServer/net/Poller.h>
+#include <WebServer/net/poller/PollPoller.h>
+#include <WebServer/net/poller/EPollPoller.h>
+#include <WebServer/net/poller/IoUringPoller.h>
+
+#include <stdlib.h>
+
+using namespace muduo::net;
+
+// 默认使用epoll，可以通过环境变量选择poll或者io_uring
+Poller* Poller::newDefaultPoller(EventLoop* loop)
+{
+    if (::getenv("MUDUO_USE_POLL")) {
+        return new PollPoller(loop);
+    }
+    else if (::getenv("MUDUO_USE_IOURING")) {
+        if (IoUringPoller::isSupported()) {
+            return new IoUringPoller(loop);
+        }
+        LOG_WARN << "io_uring is not supported by the kernel, fall back to epoll";
+        return new EPollPoller(loop);
+    }
+    else {
+        return new EPollPoller(loop);
+    }
+}
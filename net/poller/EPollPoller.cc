@@ -147,7 +147,10 @@ void EPollPoller::update(int operation, Channel* channel)
 {
     struct epoll_event event;
     bzero(&event, sizeof event);
-    event.events = channel->events();
+    event.events = channel->pollEvents();
+    if (channel->isEdgeTriggered()) {
+        event.events |= EPOLLET;// 边沿触发，EPOLLOUT一直注册，不再随enable/disableWriting修改
+    }
     event.data.ptr = channel;// 指针指向了通道
     int fd = channel->fd();
     // 核心就是调用了epoll_ctl函数
@@ -39,6 +39,7 @@ namespace muduo
             virtual Timestamp poll(int timeoutMs, ChannelList* activeChannels);// poll的时候会返回“活动的通道列表”
             virtual void updateChannel(Channel* channel);
             virtual void removeChannel(Channel* channel);
+            virtual bool supportsEdgeTriggered() const { return true; }
 
         }; // class PollPoller
 
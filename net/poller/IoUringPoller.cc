@@ -0,0 +1,349 @@
+#include <WebServer/net/poller/IoUringPoller.h>
+
+#include <WebServer/base/Logging.h>
+#include <WebServer/net/Channel.h>
+
+#include <algorithm>
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// io_uring中通道的2种状态，与EPollPoller一样保存在Channel::index_中
+namespace
+{
+    const int kNew = -1;
+    const int kAdded = 1;
+
+    // 取消poll请求（IORING_OP_POLL_REMOVE）本身的CQE使用0作为user_data，直接忽略
+    const uint64_t kIgnoredUserData = 0;
+
+    int sysIoUringSetup(unsigned entries, struct io_uring_params* p)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+    }
+
+    int sysIoUringEnter(int fd, unsigned toSubmit, unsigned minComplete,
+                        unsigned flags, const void* arg, size_t argSize)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit,
+                                          minComplete, flags, arg, argSize));
+    }
+
+    // 与内核共享的ring头尾指针，需要acquire/release语义
+    unsigned loadAcquire(const unsigned* p)
+    {
+        return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+    }
+
+    void storeRelease(unsigned* p, unsigned v)
+    {
+        __atomic_store_n(p, v, __ATOMIC_RELEASE);
+    }
+}
+
+IoUringPoller::IoUringPoller(EventLoop* loop)
+    : Poller(loop),
+      ringFd_(-1),
+      sqRing_(MAP_FAILED),
+      sqRingSize_(0),
+      sqHead_(NULL),
+      sqTail_(NULL),
+      sqMask_(NULL),
+      sqArray_(NULL),
+      sqEntries_(0),
+      sqes_(NULL),
+      sqesSize_(0),
+      cqRing_(MAP_FAILED),
+      cqRingSize_(0),
+      cqHead_(NULL),
+      cqTail_(NULL),
+      cqMask_(NULL),
+      cqes_(NULL),
+      sqeTail_(0),
+      nextGeneration_(1)
+{
+    struct io_uring_params params;
+    bzero(&params, sizeof params);
+    params.flags = IORING_SETUP_CLAMP;
+    ringFd_ = sysIoUringSetup(kRingEntries, &params);
+    if (ringFd_ < 0) {
+        LOG_SYSFATAL << "IoUringPoller::IoUringPoller";
+    }
+    // poll()的超时需要通过io_uring_getevents_arg传入
+    if (!(params.features & IORING_FEAT_EXT_ARG)) {
+        LOG_FATAL << "IoUringPoller::IoUringPoller - IORING_FEAT_EXT_ARG is not supported";
+    }
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    const bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap) {
+        // SQ和CQ两个ring共用一次mmap
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+    sqRing_ = ::mmap(NULL, sqRingSize_, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+        LOG_SYSFATAL << "IoUringPoller::IoUringPoller - mmap sq ring";
+    }
+    if (singleMmap) {
+        cqRing_ = sqRing_;
+    }
+    else {
+        cqRing_ = ::mmap(NULL, cqRingSize_, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) {
+            LOG_SYSFATAL << "IoUringPoller::IoUringPoller - mmap cq ring";
+        }
+    }
+    sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = ::mmap(NULL, sqesSize_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        LOG_SYSFATAL << "IoUringPoller::IoUringPoller - mmap sqes";
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sqRing_);
+    sqHead_  = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_  = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sqEntries_ = params.sq_entries;
+    sqeTail_ = *sqTail_;
+
+    char* cq = static_cast<char*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_   = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    LOG_TRACE << "io_uring fd = " << ringFd_ << " sq entries = " << params.sq_entries
+              << " cq entries = " << params.cq_entries;
+}
+
+IoUringPoller::~IoUringPoller()
+{
+    ::munmap(sqes_, sqesSize_);
+    if (cqRing_ != sqRing_) {
+        ::munmap(cqRing_, cqRingSize_);
+    }
+    ::munmap(sqRing_, sqRingSize_);
+    ::close(ringFd_);   // 关闭ring时内核会取消所有未完成的poll请求
+}
+
+bool IoUringPoller::isSupported()
+{
+    struct io_uring_params params;
+    bzero(&params, sizeof params);
+    int fd = sysIoUringSetup(1, &params);
+    if (fd < 0) {
+        return false;   // ENOSYS，或者被kernel.io_uring_disabled/seccomp禁止
+    }
+    ::close(fd);
+    return (params.features & IORING_FEAT_EXT_ARG) != 0;
+}
+
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList* activeChannels)
+{
+    // 上一轮中变化的关注事件，在这里和等待一起，用一次io_uring_enter提交
+    flushDirtyChannels();
+    int ret = enter(1, timeoutMs);
+    int savedErrno = errno;
+    Timestamp now(Timestamp::now());
+    if (ret < 0 && savedErrno != ETIME && savedErrno != EINTR) {
+        errno = savedErrno;
+        LOG_SYSERR << "IoUringPoller::poll()";
+    }
+    size_t numBefore = activeChannels->size();
+    fillActiveChannels(activeChannels);
+    if (activeChannels->size() > numBefore) {
+        LOG_TRACE << activeChannels->size() - numBefore << " events happended";
+    }
+    else {
+        LOG_TRACE << " nothing happended";
+    }
+    return now;
+}
+
+int IoUringPoller::enter(unsigned minComplete, int timeoutMs)
+{
+    storeRelease(sqTail_, sqeTail_);
+    unsigned toSubmit = sqeTail_ - loadAcquire(sqHead_);
+    unsigned flags = 0;
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    bzero(&arg, sizeof arg);
+    if (minComplete > 0) {
+        flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        if (timeoutMs >= 0) {
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+            arg.ts = reinterpret_cast<uintptr_t>(&ts);
+        }
+    }
+    if (toSubmit == 0 && minComplete == 0) {
+        return 0;
+    }
+    return sysIoUringEnter(ringFd_, toSubmit, minComplete, flags,
+                           flags ? &arg : NULL, flags ? sizeof arg : 0);
+}
+
+struct io_uring_sqe* IoUringPoller::getSqe()
+{
+    if (sqeTail_ - loadAcquire(sqHead_) >= sqEntries_) {
+        // SQ满了，先把已经排队的提交掉（不等待）
+        if (enter(0, 0) < 0) {
+            LOG_SYSERR << "IoUringPoller::getSqe";
+        }
+    }
+    unsigned index = sqeTail_ & *sqMask_;
+    struct io_uring_sqe* sqe = &sqes_[index];
+    bzero(sqe, sizeof *sqe);
+    sqArray_[index] = index;
+    ++sqeTail_;
+    return sqe;
+}
+
+void IoUringPoller::armChannel(int fd, Entry* entry)
+{
+    assert(!entry->armed);
+    entry->generation = nextGeneration_++;
+    if (nextGeneration_ == 0) {
+        nextGeneration_ = 1;    // 0保留给“没有请求”
+    }
+    entry->armedEvents = entry->channel->events();
+    entry->armed = true;
+
+    // 一次性（one-shot）的poll请求，与poll(2)一样是电平触发的：
+    // 提交时如果fd已经就绪，会立即完成
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = entry->armedEvents;
+    sqe->user_data = encode(fd, entry->generation);
+}
+
+void IoUringPoller::disarmChannel(int fd, Entry* entry)
+{
+    assert(entry->armed);
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = encode(fd, entry->generation);
+    sqe->user_data = kIgnoredUserData;
+    entry->generation = 0;  // 被取消的请求的CQE（-ECANCELED）不会再匹配
+    entry->armed = false;
+}
+
+void IoUringPoller::markDirty(int fd, Entry* entry)
+{
+    if (!entry->dirty) {
+        entry->dirty = true;
+        dirtyFds_.push_back(fd);
+    }
+}
+
+void IoUringPoller::flushDirtyChannels()
+{
+    for (size_t i = 0; i < dirtyFds_.size(); ++i) {
+        int fd = dirtyFds_[i];
+        ChannelMap::iterator it = channels_.find(fd);
+        if (it == channels_.end() || !it->second.dirty) {
+            continue;   // 已经被移除，或者同一个fd重复出现
+        }
+        Entry& entry = it->second;
+        entry.dirty = false;
+        const int events = entry.channel->events();
+        if (entry.armed && entry.armedEvents == events) {
+            continue;   // 内核中的请求仍然有效
+        }
+        if (entry.armed) {
+            disarmChannel(fd, &entry);
+        }
+        if (!entry.channel->isNoneEvent()) {
+            armChannel(fd, &entry);
+        }
+    }
+    dirtyFds_.clear();
+}
+
+void IoUringPoller::fillActiveChannels(ChannelList* activeChannels)
+{
+    unsigned head = *cqHead_;
+    const unsigned tail = loadAcquire(cqTail_);
+    for (; head != tail; ++head) {
+        const struct io_uring_cqe& cqe = cqes_[head & *cqMask_];
+        if (cqe.user_data == kIgnoredUserData) {
+            continue;
+        }
+        int fd = static_cast<int>(cqe.user_data >> 32);
+        uint32_t generation = static_cast<uint32_t>(cqe.user_data);
+        ChannelMap::iterator it = channels_.find(fd);
+        if (it == channels_.end() || it->second.generation != generation) {
+            continue;   // 已经被取消或替换的请求
+        }
+        Entry& entry = it->second;
+        entry.armed = false;        // one-shot请求已经完成
+        entry.generation = 0;
+        markDirty(fd, &entry);      // 下一次poll()时按照当时关注的事件重新提交
+        if (cqe.res < 0) {
+            LOG_ERROR << "IoUringPoller poll fd = " << fd << " error = " << -cqe.res;
+            entry.channel->set_revents(POLLERR);
+        }
+        else {
+            entry.channel->set_revents(cqe.res);
+        }
+        activeChannels->push_back(entry.channel);
+    }
+    storeRelease(cqHead_, head);
+}
+
+void IoUringPoller::updateChannel(Channel* channel)
+{
+    Poller::assertInLoopThread();
+    LOG_TRACE << "fd = " << channel->fd() << " events = " << channel->events();
+    const int fd = channel->fd();
+    if (channel->index() == kNew) {
+        assert(channels_.find(fd) == channels_.end());
+        Entry entry;
+        entry.channel = channel;
+        entry.generation = 0;
+        entry.armedEvents = 0;
+        entry.armed = false;
+        entry.dirty = false;
+        channels_[fd] = entry;
+        channel->set_index(kAdded);
+    }
+    ChannelMap::iterator it = channels_.find(fd);
+    assert(it != channels_.end());
+    assert(it->second.channel == channel);
+    // 只是记录下来，不发起系统调用
+    markDirty(fd, &it->second);
+}
+
+void IoUringPoller::removeChannel(Channel* channel)
+{
+    Poller::assertInLoopThread();
+    int fd = channel->fd();
+    LOG_TRACE << "fd = " << fd;
+    ChannelMap::iterator it = channels_.find(fd);
+    assert(it != channels_.end());
+    assert(it->second.channel == channel);
+    assert(channel->isNoneEvent());
+    assert(channel->index() == kAdded);
+    if (it->second.armed) {
+        disarmChannel(fd, &it->second);
+    }
+    channels_.erase(it);
+    channel->set_index(kNew);
+}
@@ -0,0 +1,95 @@
+/*
+IoUringPoller类是Poller的派生类
+
+IoUringPoller类是对io_uring（IORING_OP_POLL_ADD）的封装
+- 关注事件的增加、修改、删除都只是往提交队列（SQ）中放一个SQE，不发起系统调用
+- 在poll()中用一次io_uring_enter同时提交所有排队的SQE并等待完成事件（CQE）
+- 这样Channel::enableWriting/disableWriting不再需要每次都调用epoll_ctl
+*/
+
+#ifndef MUDUO_NET_POLLER_IOURINGPOLLER_H
+#define MUDUO_NET_POLLER_IOURINGPOLLER_H
+
+#include <WebServer/net/Poller.h>
+#include <map>
+#include <vector>
+
+#include <stdint.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace muduo
+{
+    namespace net
+    {
+        class IoUringPoller : public Poller
+        {
+        private:
+            static const unsigned kRingEntries = 1024;  // 提交队列的大小
+
+            struct Entry
+            {
+                Channel* channel;
+                uint32_t generation;    // 当前已提交的poll请求的编号，用来识别过期的CQE，0表示没有
+                int      armedEvents;   // 已提交的poll请求所关注的事件
+                bool     armed;         // 内核中是否有该fd的poll请求
+                bool     dirty;         // 是否已经在dirtyFds_中
+            };
+            typedef std::map<int, Entry> ChannelMap;    // key是文件描述符fd
+
+            io_uring_sqe* getSqe();                     // 取一个空闲的SQE，队列满时先提交
+            int  enter(unsigned minComplete, int timeoutMs); // 提交所有排队的SQE，并等待至少minComplete个CQE
+            void markDirty(int fd, Entry* entry);
+            void armChannel(int fd, Entry* entry);      // 排队IORING_OP_POLL_ADD
+            void disarmChannel(int fd, Entry* entry);   // 排队IORING_OP_POLL_REMOVE
+            void flushDirtyChannels();                  // 为需要（重新）关注的通道提交SQE
+            void fillActiveChannels(ChannelList* activeChannels);
+
+            static uint64_t encode(int fd, uint32_t generation)
+            { return (static_cast<uint64_t>(fd) << 32) | generation; }
+
+            int       ringFd_;
+            // SQ ring
+            void*     sqRing_;
+            size_t    sqRingSize_;
+            unsigned* sqHead_;
+            unsigned* sqTail_;
+            unsigned* sqMask_;
+            unsigned* sqArray_;
+            unsigned  sqEntries_;
+            io_uring_sqe* sqes_;
+            size_t    sqesSize_;
+            // CQ ring
+            void*     cqRing_;
+            size_t    cqRingSize_;
+            unsigned* cqHead_;
+            unsigned* cqTail_;
+            unsigned* cqMask_;
+            io_uring_cqe* cqes_;
+
+            unsigned  sqeTail_;         // 本地的SQ尾部，提交时才写回*sqTail_
+            uint32_t  nextGeneration_;
+            ChannelMap channels_;       // 所关注的通道列表
+            std::vector<int> dirtyFds_; // 关注的事件有变化、或者one-shot请求已经完成需要重新提交的fd
+
+        public:
+            IoUringPoller(EventLoop* loop);
+            virtual ~IoUringPoller();
+
+            virtual Timestamp poll(int timeoutMs, ChannelList* activeChannels);
+            virtual void updateChannel(Channel* channel);
+            virtual void removeChannel(Channel* channel);
+
+            /// Whether the running kernel supports what this poller needs
+            /// (io_uring with IORING_FEAT_EXT_ARG, Linux 5.11+).
+            static bool isSupported();
+
+        }; // class IoUringPoller
+
+    } // namespace net
+
+} // namespace muduo
+
+
+#endif // MUDUO_NET_POLLER_IOURINGPOLLER_H
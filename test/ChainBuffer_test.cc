@@ -0,0 +1,107 @@
+#include <WebServer/net/BlockPool.h>
+#include <WebServer/net/ChainBuffer.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+using muduo::string;
+using muduo::net::BlockPool;
+using muduo::net::BlockPoolPtr;
+using muduo::net::ChainBuffer;
+using muduo::net::ChunkPtr;
+
+void testAppendRetrieve()
+{
+    BlockPoolPtr pool(new BlockPool(64, 4));    // 小block，方便跨block测试
+    {
+        ChainBuffer buf(pool);
+        assert(buf.readableBytes() == 0);
+
+        string data(200, 'x');
+        buf.append(data);
+        assert(buf.readableBytes() == 200);
+        assert(buf.numBlocks() == 4);           // 200 = 64 * 3 + 8
+        assert(buf.contiguousBytes() == 64);
+
+        buf.retrieve(70);                       // 第一个block被归还
+        assert(buf.readableBytes() == 130);
+        assert(buf.numBlocks() == 3);
+        assert(pool->numInUse() == 3);
+
+        string rest = buf.retrieveAllAsString();
+        assert(rest == string(130, 'x'));
+        assert(buf.readableBytes() == 0);
+        assert(buf.numBlocks() == 1);           // 保留最后一个block继续写
+    }
+    assert(pool->numInUse() == 0);
+    assert(pool->numSlabs() == 1);
+}
+
+void testInt()
+{
+    BlockPoolPtr pool(new BlockPool(64, 4));
+    ChainBuffer buf(pool);
+    buf.append(string(62, 'y'));
+    buf.appendInt32(0x12345678);                // 跨越两个block
+    buf.retrieve(62);
+    assert(buf.peekInt32() == 0x12345678);
+    assert(buf.readInt32() == 0x12345678);
+    assert(buf.readableBytes() == 0);
+}
+
+void testChunk()
+{
+    BlockPoolPtr pool(new BlockPool(64, 4));
+    ChainBuffer buf(pool);
+    ChunkPtr chunk(new string("hello, chunk"));
+    buf.append("<", 1);
+    buf.append(chunk, 7);                       // 按引用挂上"chunk"，不拷贝
+    buf.append(">", 1);                         // 链尾是chunk，需要新的block
+    assert(buf.numBlocks() == 3);
+    assert(chunk.use_count() == 2);
+    assert(buf.retrieveAllAsString() == "<chunk>");
+    assert(chunk.use_count() == 1);
+    assert(pool->numInUse() == 1);
+}
+
+void testIovecAndFd()
+{
+    BlockPoolPtr pool(new BlockPool(64, 4));
+    ChainBuffer out(pool);
+    for (int i = 0; i < 10; ++i) {
+        out.append("0123456789abcdef0123456789abcdef", 32);
+    }
+    struct iovec vec[16];
+    int cnt = out.readableIovecs(vec, 16);
+    assert(cnt == 5);
+
+    int fds[2];
+    int ret = ::pipe(fds);
+    assert(ret == 0); (void)ret;
+    int savedErrno = 0;
+    ssize_t n = out.writeFd(fds[1], &savedErrno);   // 一次writev发送所有block
+    assert(n == 320); (void)n;
+    assert(out.readableBytes() == 0);
+
+    ChainBuffer in(pool);
+    size_t total = 0;
+    while (total < 320) {
+        n = in.readFd(fds[0], &savedErrno);
+        assert(n > 0);
+        total += n;
+    }
+    assert(in.readableBytes() == 320);
+    assert(in.retrieveAsString(32) == "0123456789abcdef0123456789abcdef");
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+int main()
+{
+    testAppendRetrieve();
+    testInt();
+    testChunk();
+    testIovecAndFd();
+    printf("ChainBuffer tests passed\n");
+}
@@ -0,0 +1,107 @@
+/*
+边沿触发 + stopRead() + 部分写：
+    连接建立后服务端stopRead()，此时没有待发送的数据，然后发送一个大于socket缓冲区的消息并shutdown()
+    客户端先不读，等一会儿再读，服务端要靠POLLOUT把剩下的数据发完，最后关闭写端，客户端读到EOF
+    客户端在连接后马上发送"ping"，服务端写完之后startRead()，要能收到暂停期间到达的数据
+*/
+
+#include <WebServer/base/Thread.h>
+#include <WebServer/net/EventLoop.h>
+#include <WebServer/net/InetAddress.h>
+#include <WebServer/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const int kMessageSize = 8 * 1024 * 1024;  // 大于发送和接收缓冲区之和
+EventLoop* g_loop;
+bool g_gotPing = false;
+
+void onConnection(const TcpConnectionPtr& conn)
+{
+    if (conn->connected()) {
+        conn->stopRead();   // 输出缓冲区为空时暂停读
+        conn->send(string(kMessageSize, 'x'));
+        conn->shutdown();   // 写完之后才关闭写端
+    }
+    else {
+        assert(g_gotPing);
+        g_loop->quit();
+    }
+}
+
+void onWriteComplete(const TcpConnectionPtr& conn)
+{
+    conn->startRead();
+}
+
+void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+    string msg(buf->retrieveAllAsString());
+    printf("%s received %s\n", conn->name().c_str(), msg.c_str());
+    assert(msg == "ping");
+    g_gotPing = true;
+}
+
+void client(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) < 0) {
+        perror("connect");
+        abort();
+    }
+    struct timeval timeout = { 5, 0 };// 数据卡在服务端时不要一直阻塞
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+    ssize_t nw = ::write(fd, "ping", 4);
+    assert(nw == 4);
+    (void)nw;
+    usleep(200 * 1000);// 让服务端的发送缓冲区写满
+
+    int64_t received = 0;
+    char buf[64 * 1024];
+    ssize_t n = 0;
+    while ((n = ::read(fd, buf, sizeof buf)) > 0) {
+        received += n;
+    }
+    if (n < 0) {
+        perror("read");
+    }
+    printf("received %lld bytes\n", static_cast<long long>(received));
+    assert(n == 0 && received == kMessageSize);
+    ::close(fd);// 服务端看到连接断开后退出
+}
+
+int main()
+{
+    const uint16_t port = 9982;
+    EventLoop loop;
+    g_loop = &loop;
+    TcpServer server(&loop, InetAddress(port), "EdgeTriggered_test");
+    server.setEdgeTriggered(true);
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.setWriteCompleteCallback(onWriteComplete);
+    server.start();
+
+    Thread clientThread(boost::bind(client, port), "client");
+    clientThread.start();
+    loop.loop();
+    clientThread.join();
+    printf("done\n");
+}
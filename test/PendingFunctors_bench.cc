@@ -0,0 +1,256 @@
+/*
+比较EventLoop跨线程投递任务（queueInLoop）的两种实现：
+    mutex   ：MutexLock保护的vector，每次投递都写eventfd（原来的实现）
+    lockfree：MpscQueue无锁队列，只有消费者将要阻塞时才写eventfd（合并唤醒）
+消费者线程模拟EventLoop::loop()：poll(eventfd) -> 执行所有任务
+用法：PendingFunctors_bench [生产者线程数] [每个线程投递的任务数]
+*/
+
+#include <WebServer/base/CountDownLatch.h>
+#include <WebServer/base/MpscQueue.h>
+#include <WebServer/base/Mutex.h>
+#include <WebServer/base/Thread.h>
+#include <WebServer/base/Timestamp.h>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <vector>
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+typedef boost::function<void()> Functor;
+
+// 两种实现共用的“EventLoop”骨架
+class LoopBase : boost::noncopyable
+{
+public:
+    LoopBase()
+        : wakeupFd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+          numWakeups_(0),
+          numPolls_(0),
+          quit_(false)
+    {}
+
+    virtual ~LoopBase() { ::close(wakeupFd_); }
+
+    virtual void post(const Functor& cb) = 0;
+
+    void loop()
+    {
+        while (!__atomic_load_n(&quit_, __ATOMIC_ACQUIRE)) {
+            int timeoutMs = beforePoll() ? 1000 : 0;
+            struct pollfd pfd = { wakeupFd_, POLLIN, 0 };
+            ::poll(&pfd, 1, timeoutMs);
+            ++numPolls_;
+            afterPoll();
+            if (pfd.revents & POLLIN) {
+                uint64_t one;
+                ssize_t n = ::read(wakeupFd_, &one, sizeof one);
+                (void)n;
+                onWakeupRead();
+            }
+            doPendingFunctors();
+        }
+    }
+
+    void quit()
+    {
+        __atomic_store_n(&quit_, true, __ATOMIC_RELEASE);
+        wakeup();
+    }
+
+    int64_t numWakeups() const { return __atomic_load_n(&numWakeups_, __ATOMIC_RELAXED); }
+    int64_t numPolls() const { return numPolls_; }
+
+protected:
+    // 返回是否可以阻塞
+    virtual bool beforePoll() { return true; }
+    virtual void afterPoll() {}
+    virtual void onWakeupRead() {}
+    virtual void doPendingFunctors() = 0;
+
+    void wakeup()
+    {
+        __atomic_add_fetch(&numWakeups_, 1, __ATOMIC_RELAXED);
+        uint64_t one = 1;
+        ssize_t n = ::write(wakeupFd_, &one, sizeof one);
+        (void)n;
+    }
+
+private:
+    int wakeupFd_;
+    int64_t numWakeups_;
+    int64_t numPolls_;
+    bool quit_;
+};
+
+// 原来的实现
+class MutexLoop : public LoopBase
+{
+public:
+    virtual void post(const Functor& cb)
+    {
+        {
+            muduo::MutexLockGuard lock(mutex_);
+            pendingFunctors_.push_back(cb);
+        }
+        wakeup();   // 跨线程调用总是唤醒
+    }
+
+private:
+    virtual void doPendingFunctors()
+    {
+        std::vector<Functor> functors;
+        {
+            muduo::MutexLockGuard lock(mutex_);
+            functors.swap(pendingFunctors_);
+        }
+        for (size_t i = 0; i < functors.size(); ++i) {
+            functors[i]();
+        }
+    }
+
+    muduo::MutexLock mutex_;
+    std::vector<Functor> pendingFunctors_;
+};
+
+void runFunctor(const Functor& functor)
+{
+    functor();
+}
+
+// 与EventLoop中的实现相同
+class LockFreeLoop : public LoopBase
+{
+public:
+    LockFreeLoop()
+        : sleeping_(false),
+          wakeupPending_(false)
+    {}
+
+    virtual void post(const Functor& cb)
+    {
+        pendingFunctors_.push(cb);
+        if (__atomic_load_n(&sleeping_, __ATOMIC_SEQ_CST)
+            && !__atomic_exchange_n(&wakeupPending_, true, __ATOMIC_ACQ_REL))
+        {
+            wakeup();
+        }
+    }
+
+private:
+    virtual bool beforePoll()
+    {
+        __atomic_store_n(&sleeping_, true, __ATOMIC_SEQ_CST);
+        if (!pendingFunctors_.empty()) {
+            __atomic_store_n(&sleeping_, false, __ATOMIC_RELAXED);
+            return false;
+        }
+        return true;
+    }
+
+    virtual void afterPoll()
+    {
+        __atomic_store_n(&sleeping_, false, __ATOMIC_RELAXED);
+    }
+
+    virtual void onWakeupRead()
+    {
+        __atomic_store_n(&wakeupPending_, false, __ATOMIC_RELEASE);
+    }
+
+    virtual void doPendingFunctors()
+    {
+        pendingFunctors_.consume(runFunctor);
+    }
+
+    muduo::MpscQueue<Functor> pendingFunctors_;
+    bool sleeping_;
+    bool wakeupPending_;
+};
+
+class Bench : boost::noncopyable
+{
+public:
+    Bench(LoopBase* loop, int numProducers, int numPosts)
+        : loop_(loop),
+          numProducers_(numProducers),
+          numPosts_(numPosts),
+          latch_(numProducers),
+          done_(0)
+    {}
+
+    // 返回每秒投递的任务数
+    double run()
+    {
+        muduo::Thread consumer(boost::bind(&LoopBase::loop, loop_), "consumer");
+        consumer.start();
+
+        boost::ptr_vector<muduo::Thread> producers;
+        for (int i = 0; i < numProducers_; ++i) {
+            producers.push_back(new muduo::Thread(boost::bind(&Bench::produce, this), "producer"));
+        }
+        muduo::Timestamp start(muduo::Timestamp::now());
+        for (int i = 0; i < numProducers_; ++i) {
+            producers[i].start();
+        }
+        for (int i = 0; i < numProducers_; ++i) {
+            producers[i].join();
+        }
+        const int64_t total = static_cast<int64_t>(numProducers_) * numPosts_;
+        while (__atomic_load_n(&done_, __ATOMIC_ACQUIRE) < total) {
+            ::usleep(100);
+        }
+        double seconds = timeDifference(muduo::Timestamp::now(), start);
+        loop_->quit();
+        consumer.join();
+        return static_cast<double>(total) / seconds;
+    }
+
+private:
+    void produce()
+    {
+        latch_.countDown();
+        latch_.wait();  // 所有生产者同时开始
+        for (int i = 0; i < numPosts_; ++i) {
+            loop_->post(boost::bind(&Bench::onFunctor, this));
+        }
+    }
+
+    void onFunctor()
+    {
+        // 只在消费者线程中修改
+        __atomic_store_n(&done_, done_ + 1, __ATOMIC_RELEASE);
+    }
+
+    LoopBase* loop_;
+    const int numProducers_;
+    const int numPosts_;
+    muduo::CountDownLatch latch_;
+    int64_t done_;
+};
+
+int main(int argc, char* argv[])
+{
+    int numProducers = argc > 1 ? atoi(argv[1]) : 4;
+    int numPosts = argc > 2 ? atoi(argv[2]) : 1000000;
+
+    {
+        MutexLoop loop;
+        double rate = Bench(&loop, numProducers, numPosts).run();
+        printf("mutex    : %8.0f posts/s, %lld eventfd writes, %lld polls\n", rate,
+               static_cast<long long>(loop.numWakeups()), static_cast<long long>(loop.numPolls()));
+    }
+    {
+        LockFreeLoop loop;
+        double rate = Bench(&loop, numProducers, numPosts).run();
+        printf("lockfree : %8.0f posts/s, %lld eventfd writes, %lld polls\n", rate,
+               static_cast<long long>(loop.numWakeups()), static_cast<long long>(loop.numPolls()));
+    }
+}
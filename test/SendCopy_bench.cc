@@ -0,0 +1,139 @@
+/*
+比较工作线程跨线程发送数据的几种方式：
+    copy  ：send(const StringPiece&)，拷贝一次到chunk中
+    buffer：send(Buffer*)，swap出Buffer的内容，不拷贝
+    chunk ：send(const ChunkPtr&)，按引用交接
+    move  ：send(string&&)，C++11
+服务端一个IO线程，连接建立后由一个工作线程发送，客户端线程用阻塞socket收完所有数据
+输出吞吐量，以及TcpConnection::copyBytesAvoided()
+用法：SendCopy_bench [copy|buffer|chunk|move] [消息数] [消息大小]
+*/
+
+#include <WebServer/base/CountDownLatch.h>
+#include <WebServer/base/Thread.h>
+#include <WebServer/base/Timestamp.h>
+#include <WebServer/net/EventLoop.h>
+#include <WebServer/net/InetAddress.h>
+#include <WebServer/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <utility>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+string g_mode = "copy";
+int g_numMessages = 100000;
+int g_messageSize = 4096;
+EventLoop* g_loop;
+boost::scoped_ptr<Thread> g_worker;
+
+void produce(const TcpConnectionPtr& conn)
+{
+    const string payload(g_messageSize, 'x');
+    Timestamp start = Timestamp::now();
+    for (int i = 0; i < g_numMessages; ++i) {
+        if (g_mode == "buffer") {
+            Buffer buf;
+            buf.append(payload);
+            conn->send(&buf);
+        }
+        else if (g_mode == "chunk") {
+            conn->send(ChunkPtr(new string(payload)));
+        }
+#if __cplusplus >= 201103L
+        else if (g_mode == "move") {
+            string message(payload);
+            conn->send(std::move(message));
+        }
+#endif
+        else {
+            conn->send(payload);
+        }
+    }
+    double seconds = timeDifference(Timestamp::now(), start);
+    printf("%s: produced %d x %d bytes in %.3f s\n",
+           g_mode.c_str(), g_numMessages, g_messageSize, seconds);
+}
+
+void onConnection(const TcpConnectionPtr& conn)
+{
+    if (conn->connected()) {
+        g_worker.reset(new Thread(boost::bind(produce, conn), "worker"));
+        g_worker->start();
+    }
+    else {
+        printf("copy bytes avoided: %lld\n",
+               static_cast<long long>(conn->copyBytesAvoided()));
+        g_loop->quit();
+    }
+}
+
+void client(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) < 0) {
+        perror("connect");
+        abort();
+    }
+    const int64_t total = static_cast<int64_t>(g_numMessages) * g_messageSize;
+    int64_t received = 0;
+    char buf[64 * 1024];
+    Timestamp start = Timestamp::now();
+    while (received < total) {
+        ssize_t n = ::read(fd, buf, sizeof buf);
+        if (n <= 0) {
+            break;
+        }
+        received += n;
+    }
+    double seconds = timeDifference(Timestamp::now(), start);
+    printf("received %lld bytes in %.3f s, %.1f MiB/s\n",
+           static_cast<long long>(received), seconds,
+           static_cast<double>(received) / seconds / 1024 / 1024);
+    ::close(fd);// 服务端看到连接断开后退出
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1) {
+        g_mode = argv[1];
+    }
+    if (argc > 2) {
+        g_numMessages = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        g_messageSize = atoi(argv[3]);
+    }
+
+    const uint16_t port = 9981;
+    EventLoop loop;
+    g_loop = &loop;
+    TcpServer server(&loop, InetAddress(port), "SendCopy_bench");
+    server.setThreadNum(1);
+    server.setConnectionCallback(onConnection);
+    server.start();
+
+    Thread clientThread(boost::bind(client, port), "client");
+    clientThread.start();
+    loop.loop();
+    clientThread.join();
+    if (g_worker) {
+        g_worker->join();
+    }
+}
@@ -0,0 +1,71 @@
+/*
+ThreadPool：
+    run()   队列满时阻塞，所有任务都会执行
+    tryRun()队列满时立即返回false
+最后输出队列深度的峰值和任务的等待时间
+*/
+
+#include <WebServer/base/Atomic.h>
+#include <WebServer/base/CountDownLatch.h>
+#include <WebServer/base/ThreadPool.h>
+
+#include <boost/bind.hpp>
+
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace muduo;
+
+AtomicInt32 g_done;
+
+void work(int ms)
+{
+    usleep(ms * 1000);
+    g_done.increment();
+}
+
+void printStats(const ThreadPool& pool)
+{
+    ThreadPool::Stats s = pool.stats();
+    printf("queue %zd, peak %zd, tasks %lld, rejected %lld, wait avg %.1f us, max %lld us\n",
+           s.queueSize, s.peakQueueSize,
+           static_cast<long long>(s.numTasks), static_cast<long long>(s.numRejected),
+           s.numTasks > 0 ? static_cast<double>(s.totalWaitUs) / static_cast<double>(s.numTasks) : 0.0,
+           static_cast<long long>(s.maxWaitUs));
+}
+
+int main()
+{
+    ThreadPool pool("worker");
+    pool.setMaxQueueSize(4);
+    pool.start(2);
+
+    for (int i = 0; i < 20; ++i) {
+        pool.run(boost::bind(work, 5));    // 队列满时阻塞
+    }
+    printStats(pool);
+
+    // 两个线程都被占住，队列放满之后tryRun()失败
+    CountDownLatch latch(1);
+    pool.run(boost::bind(&CountDownLatch::wait, &latch));
+    pool.run(boost::bind(&CountDownLatch::wait, &latch));
+    while (pool.queueSize() > 0) {
+        usleep(1000);
+    }
+    int accepted = 0;
+    for (int i = 0; i < 10; ++i) {
+        if (pool.tryRun(boost::bind(work, 0))) {
+            ++accepted;
+        }
+    }
+    assert(accepted == 4);
+    latch.countDown();
+    while (g_done.get() < 24) {
+        usleep(1000);
+    }
+    printStats(pool);
+    assert(pool.stats().numRejected == 6);
+    pool.stop();
+    printf("done\n");
+}
@@ -0,0 +1,67 @@
+/*
+时间轮：定时器不会提前到期，最多晚一个tick；取消的定时器不会运行
+*/
+
+#include <WebServer/base/Timestamp.h>
+#include <WebServer/net/EventLoop.h>
+
+#include <boost/bind.hpp>
+
+#include <assert.h>
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+EventLoop* g_loop;
+int g_fired = 0;
+int g_ticks = 0;
+TimerId g_every;
+
+void onTimer(Timestamp expected, const char* msg)
+{
+    int64_t late = Timestamp::now().microSecondsSinceEpoch() - expected.microSecondsSinceEpoch();
+    printf("%s late %lld us\n", msg, static_cast<long long>(late));
+    assert(late >= 0);
+    ++g_fired;
+}
+
+void canceled()
+{
+    assert(!"canceled timer should not run");
+}
+
+void onEvery()
+{
+    if (++g_ticks == 3) {
+        g_loop->cancel(g_every);
+    }
+}
+
+void finish()
+{
+    assert(g_fired == 4);
+    assert(g_ticks == 3);
+    printf("TimerWheel tests passed\n");
+    g_loop->quit();
+}
+
+int main()
+{
+    EventLoop loop;
+    g_loop = &loop;
+    loop.enableTimerWheel(0.001);
+
+    Timestamp now(Timestamp::now());
+    const double delays[] = { 0.0, 0.01, 0.3, 1.2 };   // 分别落在level0、level1（需要cascade）
+    for (size_t i = 0; i < sizeof delays / sizeof delays[0]; ++i) {
+        Timestamp when(addTime(now, delays[i]));
+        loop.runAt(when, boost::bind(onTimer, when, "runAt"));
+    }
+    TimerId id = loop.runAfter(0.5, canceled);
+    loop.cancel(id);
+    g_every = loop.runEvery(0.1, onEvery);
+    loop.runAfter(1.5, finish);
+
+    loop.loop();
+}